@@ -0,0 +1,283 @@
+// AMD glTFSample sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "AnimationSampler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+
+#include "Misc/Misc.h"
+#include "TraceRecorder.h"
+
+//--------------------------------------------------------------------------------------
+//
+// OnCreate
+//
+//--------------------------------------------------------------------------------------
+void AnimationSampler::OnCreate(const GLTFCommon *pGLTFCommon)
+{
+    m_clips.clear();
+
+    const json &j3 = pGLTFCommon->j3;
+    if (j3.find("animations") == j3.end())
+        return;
+
+    for (const json &animation : j3["animations"])
+    {
+        Clip clip;
+        clip.duration = 0.0f;
+
+        const json &samplers = animation["samplers"];
+        for (const json &channel : animation["channels"])
+        {
+            const json &target = channel["target"];
+            if (target.find("node") == target.end())
+                continue;
+
+            // morph target weights are not supported by the passes
+            const std::string path = target["path"];
+            if (path != "translation" && path != "rotation" && path != "scale")
+                continue;
+
+            const json &sampler = samplers[channel["sampler"].get<int>()];
+
+            tfAccessor input, output;
+            pGLTFCommon->GetBufferDetails(sampler["input"].get<int>(), &input);
+            pGLTFCommon->GetBufferDetails(sampler["output"].get<int>(), &output);
+
+            Track track;
+            track.pTimes = (const float *)input.m_data;
+            track.pValues = (const float *)output.m_data;
+            track.keyCount = (uint32_t)input.m_count;
+            track.components = (path == "rotation") ? 4 : 3;
+            track.cursor = 0;
+
+            const std::string interpolation = sampler.value("interpolation", std::string("LINEAR"));
+            if (interpolation == "STEP")
+                track.interpolation = INTERPOLATION_STEP;
+            else if (interpolation == "CUBICSPLINE")
+                track.interpolation = INTERPOLATION_CUBICSPLINE;
+            else
+                track.interpolation = INTERPOLATION_LINEAR;
+
+            if (track.keyCount == 0)
+                continue;
+
+            clip.duration = std::max(clip.duration, track.pTimes[track.keyCount - 1]);
+
+            // group the tracks by node
+            const int nodeIndex = target["node"];
+            auto it = std::find_if(clip.nodes.begin(), clip.nodes.end(), [nodeIndex](const AnimatedNode &node) { return node.nodeIndex == nodeIndex; });
+            if (it == clip.nodes.end())
+            {
+                clip.nodes.push_back({ nodeIndex, -1, -1, -1 });
+                it = clip.nodes.end() - 1;
+            }
+
+            const int trackIndex = (int)clip.tracks.size();
+            if (path == "translation")
+                it->translation = trackIndex;
+            else if (path == "rotation")
+                it->rotation = trackIndex;
+            else
+                it->scale = trackIndex;
+
+            clip.tracks.push_back(track);
+        }
+
+        m_clips.push_back(clip);
+    }
+}
+
+//--------------------------------------------------------------------------------------
+//
+// OnDestroy
+//
+//--------------------------------------------------------------------------------------
+void AnimationSampler::OnDestroy()
+{
+    m_clips.clear();
+}
+
+//--------------------------------------------------------------------------------------
+//
+// FindKey, returns the key at or before time, starting the search from the last one
+//
+//--------------------------------------------------------------------------------------
+uint32_t AnimationSampler::FindKey(Track *pTrack, float time)
+{
+    const float *pTimes = pTrack->pTimes;
+    const uint32_t last = pTrack->keyCount - 1;
+
+    uint32_t key = std::min(pTrack->cursor, last);
+
+    if (time >= pTimes[key])
+    {
+        // playing forward, usually we are still in the same interval or in the next one
+        for (uint32_t steps = 0; key < last && time >= pTimes[key + 1]; steps++)
+        {
+            if (steps == 4)
+            {
+                key = (uint32_t)(std::upper_bound(pTimes + key, pTimes + last + 1, time) - pTimes) - 1;
+                break;
+            }
+            key++;
+        }
+    }
+    else
+    {
+        // the clip looped or time went backwards
+        key = (uint32_t)(std::upper_bound(pTimes, pTimes + key, time) - pTimes);
+        key = (key > 0) ? key - 1 : 0;
+    }
+
+    pTrack->cursor = key;
+    return key;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// Sample
+//
+//--------------------------------------------------------------------------------------
+math::Vector4 AnimationSampler::Sample(Track *pTrack, float time)
+{
+    const uint32_t n = pTrack->components;
+    const bool bCubic = pTrack->interpolation == INTERPOLATION_CUBICSPLINE;
+
+    // for cubic splines the value sits between the in and the out tangents
+    auto load = [&](uint32_t key, uint32_t element)
+    {
+        const float *p = bCubic ? &pTrack->pValues[(key * 3 + element) * n] : &pTrack->pValues[key * n];
+        return math::Vector4(p[0], p[1], p[2], (n == 4) ? p[3] : 0.0f);
+    };
+
+    const uint32_t key = FindKey(pTrack, time);
+    const uint32_t next = std::min(key + 1, pTrack->keyCount - 1);
+
+    const float t0 = pTrack->pTimes[key];
+    const float t1 = pTrack->pTimes[next];
+    const float dt = t1 - t0;
+    const float frac = (dt > 0.0f) ? std::min(std::max((time - t0) / dt, 0.0f), 1.0f) : 0.0f;
+
+    if (pTrack->interpolation == INTERPOLATION_STEP || key == next)
+        return load(key, 1);
+
+    if (bCubic)
+    {
+        // cubic hermite spline, the tangents are scaled by the duration of the interval
+        const float f2 = frac * frac;
+        const float f3 = f2 * frac;
+        math::Vector4 value =
+            (2.0f * f3 - 3.0f * f2 + 1.0f) * load(key, 1) +
+            (f3 - 2.0f * f2 + frac) * dt * load(key, 2) +
+            (-2.0f * f3 + 3.0f * f2) * load(next, 1) +
+            (f3 - f2) * dt * load(next, 0);
+
+        return (n == 4) ? math::normalize(value) : value;
+    }
+
+    const math::Vector4 v0 = load(key, 1);
+    const math::Vector4 v1 = load(next, 1);
+    if (n == 4)
+    {
+        const math::Quat q = math::slerp(frac, math::Quat(v0), math::Quat(v1));
+        return math::Vector4(q);
+    }
+    return math::lerp(frac, v0, v1);
+}
+
+//--------------------------------------------------------------------------------------
+//
+// SetAnimationTime
+//
+//--------------------------------------------------------------------------------------
+void AnimationSampler::SetAnimationTime(GLTFCommon *pGLTFCommon, uint32_t animationIndex, float time)
+{
+    if (animationIndex >= m_clips.size())
+        return;
+
+    TraceScope traceScope("SetAnimationTime");
+
+    Clip &clip = m_clips[animationIndex];
+    if (clip.duration > 0.0f)
+        time = fmodf(time, clip.duration);
+
+    for (const AnimatedNode &node : clip.nodes)
+    {
+        const Transform &source = pGLTFCommon->m_nodes[node.nodeIndex].m_tranform;
+
+        const math::Vector4 translation = (node.translation >= 0) ? Sample(&clip.tracks[node.translation], time) : source.m_translation;
+        const math::Vector4 scale = (node.scale >= 0) ? Sample(&clip.tracks[node.scale], time) : source.m_scale;
+        const math::Matrix4 rotation = (node.rotation >= 0) ? math::Matrix4(math::Quat(Sample(&clip.tracks[node.rotation], time)), math::Vector3(0.0f, 0.0f, 0.0f)) : source.m_rotation;
+
+        pGLTFCommon->m_animatedMats[node.nodeIndex] = math::Matrix4::translation(translation.getXYZ()) * rotation * math::Matrix4::scale(scale.getXYZ());
+    }
+}
+
+//--------------------------------------------------------------------------------------
+//
+// Benchmark
+//
+//--------------------------------------------------------------------------------------
+void AnimationSampler::Benchmark(GLTFCommon *pGLTFCommon, uint32_t iterations)
+{
+    if (pGLTFCommon->m_animations.empty() || iterations == 0)
+        return;
+
+    const float frameTime = 1.0f / 60.0f;
+    typedef std::chrono::high_resolution_clock Clock;
+
+    // the loader's sampler
+    Clock::time_point start = Clock::now();
+    for (uint32_t i = 0; i < iterations; i++)
+        pGLTFCommon->SetAnimationTime(0, i * frameTime);
+    const double loaderMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    // ours, with the keyframe cursors
+    AnimationSampler sampler;
+    sampler.OnCreate(pGLTFCommon);
+
+    start = Clock::now();
+    for (uint32_t i = 0; i < iterations; i++)
+        sampler.SetAnimationTime(pGLTFCommon, 0, i * frameTime);
+    const double samplerMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    // both should agree on linear clips, compare the matrices at the same time
+    const float time = (iterations - 1) * frameTime;
+    std::vector<math::Matrix4> reference;
+    pGLTFCommon->SetAnimationTime(0, time);
+    reference = pGLTFCommon->m_animatedMats;
+    sampler.SetAnimationTime(pGLTFCommon, 0, time);
+
+    float maxError = 0.0f;
+    for (size_t i = 0; i < reference.size(); i++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            const math::Vector4 diff = math::absPerElem(reference[i].getCol(c) - pGLTFCommon->m_animatedMats[i].getCol(c));
+            maxError = std::max(maxError, (float)math::maxElem(diff));
+        }
+    }
+
+    Trace(format("Animation benchmark, %u frames: GLTFCommon::SetAnimationTime %.3f ms, AnimationSampler %.3f ms, max difference %f\n", iterations, loaderMs, samplerMs, maxError));
+}
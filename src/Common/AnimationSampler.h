@@ -0,0 +1,83 @@
+// AMD glTFSample sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+#include "../../libs/vectormath/vectormath.hpp"
+#include "GLTF/GltfCommon.h"
+
+//
+// Replacement for GLTFCommon::SetAnimationTime. The tracks of each clip are parsed once from the glTF, every track
+// remembers the keyframe it sampled last so a clip playing forward finds its next keyframe in constant time instead
+// of a binary search. Unlike the loader it also handles the STEP and CUBICSPLINE interpolation modes.
+//
+class AnimationSampler
+{
+public:
+    void OnCreate(const GLTFCommon *pGLTFCommon);
+    void OnDestroy();
+
+    // writes m_animatedMats for all the nodes animated by the clip, time wraps around the duration of the clip
+    void SetAnimationTime(GLTFCommon *pGLTFCommon, uint32_t animationIndex, float time);
+
+    // times GLTFCommon::SetAnimationTime against this sampler playing the first clip at 60Hz, results go to the log
+    static void Benchmark(GLTFCommon *pGLTFCommon, uint32_t iterations);
+
+private:
+    enum Interpolation
+    {
+        INTERPOLATION_STEP,
+        INTERPOLATION_LINEAR,
+        INTERPOLATION_CUBICSPLINE,
+    };
+
+    struct Track
+    {
+        const float    *pTimes;
+        const float    *pValues;        // cubic splines store in-tangent, value and out-tangent per key
+        uint32_t        keyCount;
+        uint32_t        components;     // 3 for translation and scale, 4 for rotation
+        Interpolation   interpolation;
+        uint32_t        cursor;         // key sampled last time
+    };
+
+    // tracks animating a node, -1 when that part of the transform is not animated
+    struct AnimatedNode
+    {
+        int             nodeIndex;
+        int             translation;
+        int             rotation;
+        int             scale;
+    };
+
+    struct Clip
+    {
+        float                       duration;
+        std::vector<Track>          tracks;
+        std::vector<AnimatedNode>   nodes;
+    };
+
+    static uint32_t FindKey(Track *pTrack, float time);
+    static math::Vector4 Sample(Track *pTrack, float time);
+
+    std::vector<Clip>   m_clips;
+};
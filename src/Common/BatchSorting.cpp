@@ -0,0 +1,166 @@
+// AMD glTFSample sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "BatchSorting.h"
+
+#include <cstring>
+#include <assert.h>
+
+// the bits of the key that identify the state, the rest is depth
+static const uint64_t StateMask = 0xFFFFFFFFFF000000ull;
+static const uint32_t StateIdBits = 20;
+static const uint32_t MaxStateId = (1u << StateIdBits) - 1;
+
+//--------------------------------------------------------------------------------------
+//
+// Reset
+//
+//--------------------------------------------------------------------------------------
+void BatchSorter::Reset()
+{
+    m_materialIds.clear();
+    m_primitiveIds.clear();
+    m_repeatedSorted = 0;
+    m_primitives.clear();
+    m_bOrderValid = false;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// GetStateId, looks the state up first so that the states already seen (all of them past the first frame)
+// don't allocate a node
+//
+//--------------------------------------------------------------------------------------
+uint32_t BatchSorter::GetStateId(std::unordered_map<const void *, uint32_t> *pIds, const void *pState)
+{
+    auto it = pIds->find(pState);
+    if (it != pIds->end())
+        return it->second;
+
+    // past that the ids would alias in the key and unrelated states would sort together
+    const uint32_t id = (uint32_t)pIds->size();
+    assert(id <= MaxStateId);
+    pIds->emplace(pState, id);
+    return id;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// MakeKey, 20 bits of material, 20 bits of primitive and the top 24 bits of the depth as an order preserving uint32
+//
+//--------------------------------------------------------------------------------------
+uint64_t BatchSorter::MakeKey(uint32_t materialId, uint32_t primitiveId, float depth)
+{
+    assert(materialId <= MaxStateId && primitiveId <= MaxStateId);
+
+    // flip the sign bit of the positive floats and all the bits of the negative ones so they compare as integers,
+    // dropping the low 8 bits of the mantissa only merges depths that are less than 0.003% apart
+    uint32_t depthBits;
+    memcpy(&depthBits, &depth, sizeof(depthBits));
+    depthBits ^= (depthBits & 0x80000000u) ? 0xFFFFFFFFu : 0x80000000u;
+
+    return ((uint64_t)(materialId & MaxStateId) << 44) | ((uint64_t)(primitiveId & MaxStateId) << 24) | (depthBits >> 8);
+}
+
+//--------------------------------------------------------------------------------------
+//
+// CountRepeatedStates
+//
+//--------------------------------------------------------------------------------------
+uint32_t BatchSorter::CountRepeatedStates(const uint64_t *pKeys, uint32_t count)
+{
+    uint32_t repeated = 0;
+    for (uint32_t i = 1; i < count; i++)
+        repeated += ((pKeys[i] ^ pKeys[i - 1]) & StateMask) == 0;
+    return repeated;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// Sort, 8 passes of 8 bits, the passes where all the keys fall in the same bucket are skipped
+// (most of the high bytes when there are only a few hundred materials and primitives)
+//
+//--------------------------------------------------------------------------------------
+const std::vector<uint32_t> &BatchSorter::Sort(const std::vector<uint64_t> &keys)
+{
+    const uint32_t count = (uint32_t)keys.size();
+    m_keys[0].assign(keys.begin(), keys.end());
+    m_keys[1].resize(count);
+    m_order[0].resize(count);
+    m_order[1].resize(count);
+    for (uint32_t i = 0; i < count; i++)
+        m_order[0][i] = i;
+
+    // histograms of all the passes in a single read of the keys
+    uint32_t histograms[8][256];
+    memset(histograms, 0, sizeof(histograms));
+    for (uint32_t i = 0; i < count; i++)
+    {
+        for (uint32_t pass = 0; pass < 8; pass++)
+            histograms[pass][(keys[i] >> (pass * 8)) & 0xFF]++;
+    }
+
+    uint32_t src = 0;
+    for (uint32_t pass = 0; pass < 8; pass++)
+    {
+        uint32_t *pHistogram = histograms[pass];
+        if (count == 0 || pHistogram[(keys[0] >> (pass * 8)) & 0xFF] == count)
+            continue;
+
+        uint32_t offset = 0;
+        for (uint32_t bucket = 0; bucket < 256; bucket++)
+        {
+            const uint32_t bucketSize = pHistogram[bucket];
+            pHistogram[bucket] = offset;
+            offset += bucketSize;
+        }
+
+        const uint32_t dst = src ^ 1;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const uint64_t key = m_keys[src][i];
+            const uint32_t slot = pHistogram[(key >> (pass * 8)) & 0xFF]++;
+            m_keys[dst][slot] = key;
+            m_order[dst][slot] = m_order[src][i];
+        }
+        src = dst;
+    }
+
+    m_repeatedSorted = CountRepeatedStates(m_keys[src].data(), count);
+    m_sortedIndex = src;
+    m_orderAge = 0;
+    m_bOrderValid = true;
+    return m_order[src];
+}
+
+//--------------------------------------------------------------------------------------
+//
+// IsOrderCached
+//
+//--------------------------------------------------------------------------------------
+bool BatchSorter::IsOrderCached(const std::vector<const void *> &primitives)
+{
+    if (m_bOrderValid && primitives == m_primitives && ++m_orderAge < FramesBetweenDepthSorts)
+        return true;
+
+    m_primitives.assign(primitives.begin(), primitives.end());
+    m_bOrderValid = false;
+    return false;
+}
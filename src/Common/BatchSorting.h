@@ -0,0 +1,74 @@
+// AMD glTFSample sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+//
+// Sorts the opaque batches by a 64 bit key so the ones sharing state are drawn back to back.
+// From the most significant bits down: 20 bits of material, 20 bits of primitive (each primitive has its own pipeline,
+// descriptor set and vertex buffers) and 24 bits of view depth, so batches sharing all their state still go front to back.
+//
+class BatchSorter
+{
+public:
+    // forgets the state ids, call it when the scene gets unloaded
+    void Reset();
+
+    // dense ids of the materials and the primitives, given in the order they are first seen, each kind has its own
+    // range so they both get the full width of their field in the key
+    uint32_t GetMaterialId(const void *pMaterial) { return GetStateId(&m_materialIds, pMaterial); }
+    uint32_t GetPrimitiveId(const void *pPrimitive) { return GetStateId(&m_primitiveIds, pPrimitive); }
+
+    static uint64_t MakeKey(uint32_t materialId, uint32_t primitiveId, float depth);
+
+    // LSD radix sort of the keys, returns the order the batches have to be drawn in
+    const std::vector<uint32_t> &Sort(const std::vector<uint64_t> &keys);
+
+    // true if the order of the last sort can be drawn again, that's the case while the batches reference the same
+    // primitives in the same order (the visible nodes didn't change). The depths drift as the camera moves, so the
+    // order still gets refreshed every FramesBetweenDepthSorts frames.
+    bool IsOrderCached(const std::vector<const void *> &primitives);
+    const std::vector<uint32_t> &GetOrder() const { return m_order[m_sortedIndex]; }
+
+    // batches that use the same state as the one drawn before them, after the last sort
+    uint32_t GetRepeatedStateCount() const { return m_repeatedSorted; }
+
+    static uint32_t CountRepeatedStates(const uint64_t *pKeys, uint32_t count);
+
+private:
+    static const uint32_t FramesBetweenDepthSorts = 8;
+
+    static uint32_t GetStateId(std::unordered_map<const void *, uint32_t> *pIds, const void *pState);
+
+    std::unordered_map<const void *, uint32_t> m_materialIds;
+    std::unordered_map<const void *, uint32_t> m_primitiveIds;
+
+    std::vector<uint64_t>       m_keys[2];
+    std::vector<uint32_t>       m_order[2];
+    uint32_t                    m_sortedIndex = 0;
+    uint32_t                    m_repeatedSorted = 0;
+
+    std::vector<const void *>   m_primitives;       // primitives of the batches of the last sort
+    uint32_t                    m_orderAge = 0;
+    bool                        m_bOrderValid = false;
+};
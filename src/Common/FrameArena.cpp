@@ -0,0 +1,95 @@
+// AMD glTFSample sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "FrameArena.h"
+
+#include <cstdlib>
+#include <algorithm>
+
+//--------------------------------------------------------------------------------------
+//
+// OnCreate
+//
+//--------------------------------------------------------------------------------------
+void FrameArena::OnCreate(size_t size)
+{
+    m_size = size;
+    m_pData = (uint8_t *)malloc(m_size);
+    m_offset = 0;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// OnDestroy
+//
+//--------------------------------------------------------------------------------------
+void FrameArena::OnDestroy()
+{
+    OnBeginFrame();
+
+    free(m_pData);
+    m_pData = NULL;
+    m_size = 0;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// OnBeginFrame
+//
+//--------------------------------------------------------------------------------------
+void FrameArena::OnBeginFrame()
+{
+    for (void *pData : m_heapAllocations)
+        free(pData);
+    m_heapAllocations.clear();
+
+    // the last frame didn't fit, grow the block to what it used
+    if (m_heapSize != 0 && m_pData != NULL)
+    {
+        m_size = m_offset + m_heapSize + m_heapSize / 2;
+        free(m_pData);
+        m_pData = (uint8_t *)malloc(m_size);
+    }
+
+    m_offset = 0;
+    m_heapSize = 0;
+    m_heapAllocationCount = 0;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// Alloc
+//
+//--------------------------------------------------------------------------------------
+void *FrameArena::Alloc(size_t size, size_t alignment)
+{
+    const size_t offset = (m_offset + alignment - 1) & ~(alignment - 1);
+    if (offset + size <= m_size)
+    {
+        m_offset = offset + size;
+        return m_pData + offset;
+    }
+
+    void *pData = malloc(size);
+    m_heapAllocations.push_back(pData);
+    m_heapSize += size;
+    m_heapAllocationCount++;
+    return pData;
+}
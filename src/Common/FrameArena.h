@@ -0,0 +1,91 @@
+// AMD glTFSample sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// Linear allocator for the containers that only live while a frame is being recorded. Allocations bump a pointer
+// and are all released at once by OnBeginFrame. When a frame needs more than the block holds, the extra allocations
+// go to the heap and the block grows to fit at the next OnBeginFrame, so a steady state frame never hits the heap.
+//
+class FrameArena
+{
+public:
+    void OnCreate(size_t size);
+    void OnDestroy();
+
+    // releases everything allocated during the previous frame
+    void OnBeginFrame();
+
+    // there is no Free, the memory goes away with the frame
+    void *Alloc(size_t size, size_t alignment);
+
+    // heap allocations made this frame because the block was full
+    uint32_t GetHeapAllocationCount() const { return m_heapAllocationCount; }
+    size_t GetUsedSize() const { return m_offset; }
+    size_t GetSize() const { return m_size; }
+
+private:
+    uint8_t                    *m_pData = NULL;
+    size_t                      m_size = 0;
+    size_t                      m_offset = 0;
+
+    std::vector<void *>         m_heapAllocations;
+    size_t                      m_heapSize = 0;
+    uint32_t                    m_heapAllocationCount = 0;
+};
+
+//
+// Standard allocator on top of a FrameArena, without an arena it falls back to the heap.
+// Growing a container leaves its old storage in the arena until the next frame, reserve what's known upfront.
+//
+template<typename T>
+class FrameAllocator
+{
+public:
+    typedef T value_type;
+
+    FrameAllocator(FrameArena *pArena = NULL) : m_pArena(pArena) {}
+    template<typename U> FrameAllocator(const FrameAllocator<U> &other) : m_pArena(other.m_pArena) {}
+
+    T *allocate(size_t count)
+    {
+        if (m_pArena)
+            return (T *)m_pArena->Alloc(count * sizeof(T), alignof(T));
+        return (T *)::operator new(count * sizeof(T));
+    }
+
+    void deallocate(T *pData, size_t)
+    {
+        if (!m_pArena)
+            ::operator delete(pData);
+    }
+
+    template<typename U> bool operator==(const FrameAllocator<U> &other) const { return m_pArena == other.m_pArena; }
+    template<typename U> bool operator!=(const FrameAllocator<U> &other) const { return m_pArena != other.m_pArena; }
+
+    FrameArena                 *m_pArena;
+};
+
+template<typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
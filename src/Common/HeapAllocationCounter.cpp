@@ -0,0 +1,64 @@
+// AMD glTFSample sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "HeapAllocationCounter.h"
+
+#ifdef _DEBUG
+#include <crtdbg.h>
+
+static thread_local uint64_t s_threadAllocationCount = 0;
+
+// the hook must not allocate, it runs inside the CRT's allocator
+static int AllocHook(int allocType, void *pUserData, size_t size, int blockType, long requestNumber, const unsigned char *pFilename, int lineNumber)
+{
+    if (blockType != _CRT_BLOCK && (allocType == _HOOK_ALLOC || allocType == _HOOK_REALLOC))
+        s_threadAllocationCount++;
+    return 1;
+}
+#endif
+
+//--------------------------------------------------------------------------------------
+//
+// InstallHook
+//
+//--------------------------------------------------------------------------------------
+void HeapAllocationCounter::InstallHook()
+{
+#ifdef _DEBUG
+    static bool bInstalled = false;
+    if (!bInstalled)
+        _CrtSetAllocHook(AllocHook);
+    bInstalled = true;
+#endif
+}
+
+//--------------------------------------------------------------------------------------
+//
+// GetThreadCount
+//
+//--------------------------------------------------------------------------------------
+uint64_t HeapAllocationCounter::GetThreadCount()
+{
+#ifdef _DEBUG
+    return s_threadAllocationCount;
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,234 @@
+// AMD glTFSample sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "LightSelection.h"
+
+#include <cfloat>
+#include <algorithm>
+
+#include "Misc/Misc.h"
+
+const float LightSelector::SelectedScoreBoost = 2.0f;
+
+//--------------------------------------------------------------------------------------
+//
+// LimitShadowedLights, the shadowed instances past the limit point to a copy of their light without a shadow map
+//
+//--------------------------------------------------------------------------------------
+uint32_t LightSelector::LimitShadowedLights(const GLTFCommon *pGLTFCommon, uint32_t maxShadowed)
+{
+    m_bShadowsLimited = false;
+    m_lights.clear();
+    m_instances.clear();
+
+    std::vector<int> shadowed;
+    for (int i = 0; i < (int)pGLTFCommon->m_lightInstances.size(); i++)
+    {
+        if (pGLTFCommon->m_lights[pGLTFCommon->m_lightInstances[i].m_lightId].m_shadowResolution)
+            shadowed.push_back(i);
+    }
+
+    if (shadowed.size() <= maxShadowed)
+        return 0;
+
+    // directional lights cover the whole scene, they keep their shadows first
+    std::stable_sort(shadowed.begin(), shadowed.end(), [pGLTFCommon](int a, int b)
+    {
+        const bool bDirectionalA = pGLTFCommon->m_lights[pGLTFCommon->m_lightInstances[a].m_lightId].m_type == tfLight::LIGHT_DIRECTIONAL;
+        const bool bDirectionalB = pGLTFCommon->m_lights[pGLTFCommon->m_lightInstances[b].m_lightId].m_type == tfLight::LIGHT_DIRECTIONAL;
+        return bDirectionalA && !bDirectionalB;
+    });
+
+    // the light definitions can be shared by several instances, so the ones losing their shadow point to a copy
+    m_lights = pGLTFCommon->m_lights;
+    m_instances = pGLTFCommon->m_lightInstances;
+    std::vector<int> unshadowedCopy(m_lights.size(), -1);
+    for (size_t i = maxShadowed; i < shadowed.size(); i++)
+    {
+        int &lightId = m_instances[shadowed[i]].m_lightId;
+        if (unshadowedCopy[lightId] < 0)
+        {
+            tfLight light = m_lights[lightId];
+            light.m_shadowResolution = 0;
+            unshadowedCopy[lightId] = (int)m_lights.size();
+            m_lights.push_back(light);
+        }
+        lightId = unshadowedCopy[lightId];
+    }
+
+    m_bShadowsLimited = true;
+    return (uint32_t)(shadowed.size() - maxShadowed);
+}
+
+//--------------------------------------------------------------------------------------
+//
+// Reset
+//
+//--------------------------------------------------------------------------------------
+void LightSelector::Reset()
+{
+    m_slots.clear();
+    m_wasSelected.clear();
+    m_selected.clear();
+    m_selectedCount = 0;
+    m_bSubset = false;
+    m_bSubsetTraced = false;
+
+    m_lights.clear();
+    m_instances.clear();
+    m_bShadowsLimited = false;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// HasShadow
+//
+//--------------------------------------------------------------------------------------
+bool LightSelector::HasShadow(const GLTFCommon *pGLTFCommon, uint32_t lightInstance) const
+{
+    if (m_bShadowsLimited)
+        return m_lights[m_instances[lightInstance].m_lightId].m_shadowResolution != 0;
+    return pGLTFCommon->m_lights[pGLTFCommon->m_lightInstances[lightInstance].m_lightId].m_shadowResolution != 0;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// Select
+//
+//--------------------------------------------------------------------------------------
+void LightSelector::Select(const GLTFCommon *pGLTFCommon, const math::Matrix4 &viewProj, const math::Vector4 &cameraPos, uint32_t maxLights)
+{
+    const LightInstanceList &instances = m_bShadowsLimited ? m_instances : pGLTFCommon->m_lightInstances;
+    const LightList &lights = m_bShadowsLimited ? m_lights : pGLTFCommon->m_lights;
+    const uint32_t lightCount = (uint32_t)instances.size();
+
+    m_slots.resize(lightCount);
+    m_selected.clear();
+
+    // everything fits, only the lights that lost their shadow need swapping in
+    m_bSubset = lightCount > maxLights;
+    if (!m_bSubset)
+    {
+        for (uint32_t i = 0; i < lightCount; i++)
+            m_slots[i] = (int)i;
+        if (m_bShadowsLimited)
+            m_selected = m_instances;
+        m_selectedCount = lightCount;
+        return;
+    }
+
+    if (!m_bSubsetTraced)
+    {
+        Trace(format("%u light instances exceed the %u the per frame constants hold, the ones lighting the view are selected every frame\n", lightCount, maxLights));
+        m_bSubsetTraced = true;
+    }
+
+    // normalized frustum planes, so the distance to them can be compared with the light ranges
+    const math::Vector4 r0 = viewProj.getRow(0);
+    const math::Vector4 r1 = viewProj.getRow(1);
+    const math::Vector4 r2 = viewProj.getRow(2);
+    const math::Vector4 r3 = viewProj.getRow(3);
+    math::Vector4 planes[6] = { r3 + r0, r3 - r0, r3 + r1, r3 - r1, r2, r3 - r2 };
+    for (int p = 0; p < 6; p++)
+        planes[p] /= math::length(planes[p].getXYZ());
+
+    // the shadowed lights always go in, their shadow map indices are given in instance order
+    std::vector<uint8_t> &keep = m_keep;
+    keep.assign(lightCount, 0);
+    m_wasSelected.resize(lightCount, 0);
+    uint32_t keptCount = 0;
+
+    m_candidates.clear();
+    for (uint32_t i = 0; i < lightCount; i++)
+    {
+        const tfLight &light = lights[instances[i].m_lightId];
+        if (light.m_shadowResolution)
+        {
+            keep[i] = 1;
+            keptCount++;
+            continue;
+        }
+
+        if (light.m_type == tfLight::LIGHT_DIRECTIONAL)
+        {
+            m_candidates.push_back(std::make_pair(FLT_MAX, (int)i));
+            continue;
+        }
+
+        const math::Vector3 position = pGLTFCommon->m_worldSpaceMats[instances[i].m_nodeIndex].GetCurrent().getCol3().getXYZ();
+
+        // a range of 0 means the light has no cutoff
+        if (light.m_range > 0.0f)
+        {
+            bool bOutside = false;
+            for (int p = 0; p < 6 && !bOutside; p++)
+                bOutside = math::dot(planes[p].getXYZ(), position) + planes[p].getW() < -light.m_range;
+            if (bOutside)
+                continue;
+        }
+
+        const float distanceSqr = std::max(math::lengthSqr(position - cameraPos.getXYZ()), 1e-4f);
+        const float score = light.m_intensity / distanceSqr;
+        m_candidates.push_back(std::make_pair(m_wasSelected[i] ? score * SelectedScoreBoost : score, (int)i));
+    }
+
+    const size_t freeSlots = maxLights > keptCount ? maxLights - keptCount : 0;
+    if (m_candidates.size() > freeSlots)
+    {
+        std::nth_element(m_candidates.begin(), m_candidates.begin() + freeSlots, m_candidates.end(),
+            [](const std::pair<float, int> &a, const std::pair<float, int> &b) { return a.first > b.first; });
+        m_candidates.resize(freeSlots);
+    }
+    for (const std::pair<float, int> &candidate : m_candidates)
+        keep[candidate.second] = 1;
+
+    for (uint32_t i = 0; i < lightCount; i++)
+    {
+        m_slots[i] = keep[i] ? (int)m_selected.size() : -1;
+        m_wasSelected[i] = keep[i];
+        if (keep[i])
+            m_selected.push_back(instances[i]);
+    }
+    m_selectedCount = (uint32_t)m_selected.size();
+}
+
+//--------------------------------------------------------------------------------------
+//
+// ScopedLightSelection
+//
+//--------------------------------------------------------------------------------------
+ScopedLightSelection::ScopedLightSelection(GLTFCommon *pGLTFCommon, LightSelector *pSelector)
+    : m_pGLTFCommon(pGLTFCommon)
+    , m_pSelector(pSelector)
+    , m_bSwapped(pSelector->m_bSubset || pSelector->m_bShadowsLimited)
+{
+    if (m_bSwapped)
+        m_pGLTFCommon->m_lightInstances.swap(m_pSelector->m_selected);
+    if (m_pSelector->m_bShadowsLimited)
+        m_pGLTFCommon->m_lights.swap(m_pSelector->m_lights);
+}
+
+ScopedLightSelection::~ScopedLightSelection()
+{
+    if (m_bSwapped)
+        m_pGLTFCommon->m_lightInstances.swap(m_pSelector->m_selected);
+    if (m_pSelector->m_bShadowsLimited)
+        m_pGLTFCommon->m_lights.swap(m_pSelector->m_lights);
+}
@@ -0,0 +1,95 @@
+// AMD glTFSample sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <windows.h>
+#include <vector>
+#include <stdint.h>
+
+#include "../../libs/vectormath/vectormath.hpp"
+#include "GLTF/GltfCommon.h"
+
+typedef decltype(GLTFCommon::m_lightInstances) LightInstanceList;
+
+typedef decltype(GLTFCommon::m_lights) LightList;
+
+//
+// The per frame constants hold at most MaxLightInstances lights and the PBR shader loops over all of them for every
+// pixel, so scenes with more light instances than that get a subset picked every frame: the shadowed lights always
+// make it, the rest are culled by their range against the view frustum and ranked by the light they bring to the camera.
+// The lights picked in the previous frame get their score boosted, so a light only loses its slot to one that brings
+// clearly more light and the selection doesn't flicker while the camera moves.
+// The glTF is never modified, the selected lights are only swapped into it while the per frame data gets filled.
+//
+class LightSelector
+{
+public:
+    // the instances past maxShadowed lose their shadow (directional lights keep theirs first), returns how many lost it
+    uint32_t LimitShadowedLights(const GLTFCommon *pGLTFCommon, uint32_t maxShadowed);
+
+    // forgets the scene, call it when the scene gets unloaded
+    void Reset();
+
+    void Select(const GLTFCommon *pGLTFCommon, const math::Matrix4 &viewProj, const math::Vector4 &cameraPos, uint32_t maxLights);
+
+    // whether a light instance gets a shadow map, LimitShadowedLights may have taken it away
+    bool HasShadow(const GLTFCommon *pGLTFCommon, uint32_t lightInstance) const;
+
+    // index in the per frame light array of a light instance, -1 if it wasn't selected
+    int GetSlot(uint32_t lightInstance) const { return lightInstance < m_slots.size() ? m_slots[lightInstance] : -1; }
+
+    uint32_t GetLightCount() const { return (uint32_t)m_slots.size(); }
+    uint32_t GetSelectedCount() const { return m_selectedCount; }
+
+private:
+    friend class ScopedLightSelection;
+
+    // how much more light a candidate needs to bring to take the slot of a light selected in the previous frame
+    static const float                      SelectedScoreBoost;
+
+    std::vector<int>                        m_slots;
+    std::vector<uint8_t>                    m_keep;
+    std::vector<uint8_t>                    m_wasSelected;
+    std::vector<std::pair<float, int>>      m_candidates;   // score, light instance
+    LightInstanceList                       m_selected;
+    uint32_t                                m_selectedCount = 0;
+    bool                                    m_bSubset = false;
+    bool                                    m_bSubsetTraced = false;
+
+    // the glTF's lights plus a copy without shadow of the ones that lost it, and the instances pointing to those
+    LightList                               m_lights;
+    LightInstanceList                       m_instances;
+    bool                                    m_bShadowsLimited = false;
+};
+
+//
+// Swaps the selected lights into the glTF for the duration of the scope, so SetPerFrameData only sees those
+//
+class ScopedLightSelection
+{
+public:
+    ScopedLightSelection(GLTFCommon *pGLTFCommon, LightSelector *pSelector);
+    ~ScopedLightSelection();
+
+private:
+    GLTFCommon                 *m_pGLTFCommon;
+    LightSelector              *m_pSelector;
+    bool                        m_bSwapped;
+};
@@ -0,0 +1,157 @@
+// AMD glTFSample sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "OcclusionCulling.h"
+
+#include <cfloat>
+#include <algorithm>
+
+//--------------------------------------------------------------------------------------
+//
+// Build
+//
+//--------------------------------------------------------------------------------------
+void DepthPyramid::Build(const float *pDepth, uint32_t width, uint32_t height, uint32_t rowPitch, const math::Matrix4 &viewProj, WorkerPool *pWorkerPool)
+{
+    m_width = width;
+    m_height = height;
+    m_viewProj = viewProj;
+
+    // allocate the levels down to 1x1, this only does something after a resize
+    uint32_t levelWidth = (width + (1 << FirstLevelShift) - 1) >> FirstLevelShift;
+    uint32_t levelHeight = (height + (1 << FirstLevelShift) - 1) >> FirstLevelShift;
+    size_t levelCount = 0;
+    for (;; levelCount++)
+    {
+        if (m_levels.size() <= levelCount)
+            m_levels.push_back(Level());
+
+        Level &level = m_levels[levelCount];
+        level.width = levelWidth;
+        level.height = levelHeight;
+        level.depth.resize((size_t)levelWidth * levelHeight);
+
+        if (levelWidth == 1 && levelHeight == 1)
+            break;
+        levelWidth = (levelWidth + 1) / 2;
+        levelHeight = (levelHeight + 1) / 2;
+    }
+    m_levels.resize(levelCount + 1);
+
+    // the first level reads the whole depth buffer, split it in bands of rows across the workers
+    Level &first = m_levels[0];
+    const uint32_t bandCount = std::min(first.height, pWorkerPool->GetThreadCount() * 4);
+    pWorkerPool->ParallelFor(bandCount, [&](uint32_t band)
+    {
+        const uint32_t firstRow = (first.height * band) / bandCount;
+        const uint32_t lastRow = (first.height * (band + 1)) / bandCount;
+        for (uint32_t y = firstRow; y < lastRow; y++)
+        {
+            float *pDst = &first.depth[(size_t)y * first.width];
+            std::fill(pDst, pDst + first.width, 0.0f);
+
+            const uint32_t srcLast = std::min((y + 1) << FirstLevelShift, height);
+            for (uint32_t srcY = y << FirstLevelShift; srcY < srcLast; srcY++)
+            {
+                const float *pSrc = (const float *)((const uint8_t *)pDepth + (size_t)srcY * rowPitch);
+                for (uint32_t srcX = 0; srcX < width; srcX++)
+                    pDst[srcX >> FirstLevelShift] = std::max(pDst[srcX >> FirstLevelShift], pSrc[srcX]);
+            }
+        }
+    });
+
+    // the rest are small enough for a single thread
+    for (size_t l = 1; l < m_levels.size(); l++)
+    {
+        const Level &src = m_levels[l - 1];
+        Level &dst = m_levels[l];
+        for (uint32_t y = 0; y < dst.height; y++)
+        {
+            const uint32_t y0 = y * 2, y1 = std::min(y * 2 + 1, src.height - 1);
+            for (uint32_t x = 0; x < dst.width; x++)
+            {
+                const uint32_t x0 = x * 2, x1 = std::min(x * 2 + 1, src.width - 1);
+                const float d0 = std::max(src.depth[y0 * src.width + x0], src.depth[y0 * src.width + x1]);
+                const float d1 = std::max(src.depth[y1 * src.width + x0], src.depth[y1 * src.width + x1]);
+                dst.depth[y * dst.width + x] = std::max(d0, d1);
+            }
+        }
+    }
+
+    m_bValid = true;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// IsOccluded, projects the corners of the box, picks the level where its rectangle covers at most 2x2 texels and
+// compares the closest depth of the box with the farthest depth stored there
+//
+//--------------------------------------------------------------------------------------
+bool DepthPyramid::IsOccluded(const math::Vector3 &center, const math::Vector3 &extent) const
+{
+    if (!m_bValid)
+        return false;
+
+    float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX, minZ = FLT_MAX;
+    for (int corner = 0; corner < 8; corner++)
+    {
+        const math::Vector3 sign((corner & 1) ? 1.0f : -1.0f, (corner & 2) ? 1.0f : -1.0f, (corner & 4) ? 1.0f : -1.0f);
+        const math::Vector4 clip = m_viewProj * math::Point3(center + math::mulPerElem(sign, extent));
+
+        // the box crosses the camera plane
+        if (clip.getW() <= 0.0f)
+            return false;
+
+        const float invW = 1.0f / clip.getW();
+        minX = std::min(minX, clip.getX() * invW);
+        maxX = std::max(maxX, clip.getX() * invW);
+        minY = std::min(minY, clip.getY() * invW);
+        maxY = std::max(maxY, clip.getY() * invW);
+        minZ = std::min(minZ, clip.getZ() * invW);
+    }
+
+    // off screen or in front of the near plane, the frustum test takes care of those
+    if (minZ < 0.0f || maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f)
+        return false;
+
+    // to pixels, y goes down
+    const int x0 = std::max(0, (int)((minX * 0.5f + 0.5f) * m_width));
+    const int x1 = std::min((int)m_width - 1, (int)((maxX * 0.5f + 0.5f) * m_width));
+    const int y0 = std::max(0, (int)((0.5f - maxY * 0.5f) * m_height));
+    const int y1 = std::min((int)m_height - 1, (int)((0.5f - minY * 0.5f) * m_height));
+
+    size_t l = 0;
+    uint32_t shift = FirstLevelShift;
+    while (l + 1 < m_levels.size() && ((x1 >> shift) - (x0 >> shift) > 1 || (y1 >> shift) - (y0 >> shift) > 1))
+    {
+        l++;
+        shift++;
+    }
+
+    const Level &level = m_levels[l];
+    float maxDepth = 0.0f;
+    for (int y = y0 >> shift; y <= (y1 >> shift); y++)
+    {
+        for (int x = x0 >> shift; x <= (x1 >> shift); x++)
+            maxDepth = std::max(maxDepth, level.depth[(size_t)y * level.width + x]);
+    }
+
+    return minZ > maxDepth;
+}
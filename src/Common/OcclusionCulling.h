@@ -0,0 +1,60 @@
+// AMD glTFSample sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+#include "../../libs/vectormath/vectormath.hpp"
+#include "WorkerPool.h"
+
+//
+// Max depth pyramid of a depth buffer read back from the GPU, for occlusion culling on the CPU.
+// The readback lags a few frames behind, so boxes get tested in the view the depth was rendered from:
+// a node that was hidden back then is assumed to still be hidden. Depth goes from 0 (near) to 1 (far).
+//
+class DepthPyramid
+{
+public:
+    // builds the pyramid from a depth buffer rendered with viewProj, rowPitch is in bytes
+    void Build(const float *pDepth, uint32_t width, uint32_t height, uint32_t rowPitch, const math::Matrix4 &viewProj, WorkerPool *pWorkerPool);
+    void Invalidate() { m_bValid = false; }
+    bool IsValid() const { return m_bValid; }
+
+    // true if the world space box is behind the depth stored in the pyramid
+    bool IsOccluded(const math::Vector3 &center, const math::Vector3 &extent) const;
+
+private:
+    // the first level keeps the max of 4x4 pixel blocks, each next level the max of 2x2 texels of the previous one
+    static const uint32_t FirstLevelShift = 2;
+
+    struct Level
+    {
+        uint32_t            width;
+        uint32_t            height;
+        std::vector<float>  depth;
+    };
+
+    std::vector<Level>          m_levels;
+    uint32_t                    m_width = 0;
+    uint32_t                    m_height = 0;
+    math::Matrix4               m_viewProj;
+    bool                        m_bValid = false;
+};
@@ -0,0 +1,398 @@
+// AMD glTFSample sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "SceneCulling.h"
+
+#include <xmmintrin.h>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+//--------------------------------------------------------------------------------------
+//
+// HasBlendedPrimitive, true if any primitive of the mesh uses a material with the BLEND alpha mode
+//
+//--------------------------------------------------------------------------------------
+static bool HasBlendedPrimitive(const GLTFCommon *pGLTFCommon, int meshIndex)
+{
+    const json &j3 = pGLTFCommon->j3;
+    if (j3.find("meshes") == j3.end() || j3.find("materials") == j3.end())
+        return false;
+
+    const json &materials = j3["materials"];
+    for (const json &primitive : j3["meshes"][meshIndex]["primitives"])
+    {
+        const int materialIndex = primitive.value("material", -1);
+        if (materialIndex >= 0 && materialIndex < (int)materials.size() && materials[materialIndex].value("alphaMode", "OPAQUE") == "BLEND")
+            return true;
+    }
+
+    return false;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// OnCreate
+//
+//--------------------------------------------------------------------------------------
+void SceneCuller::OnCreate(const GLTFCommon *pGLTFCommon)
+{
+    m_pGLTFCommon = pGLTFCommon;
+
+    m_nodeIndex.clear();
+    m_localCenter.clear();
+    m_localExtent.clear();
+    m_alwaysVisible.clear();
+    m_skinIndex.clear();
+    m_skinMoved.assign(pGLTFCommon->m_skins.size(), 0);
+    m_bSkinMoved = false;
+    m_blended.clear();
+    m_primitiveCount.clear();
+    m_totalPrimitiveCount = 0;
+
+    for (int i = 0; i < (int)pGLTFCommon->m_nodes.size(); i++)
+    {
+        const tfNode &node = pGLTFCommon->m_nodes[i];
+        if (node.meshIndex < 0)
+            continue;
+
+        // union of the boxes of all the primitives of the mesh
+        const tfMesh &mesh = pGLTFCommon->m_meshes[node.meshIndex];
+        math::Vector4 bbMin = math::Vector4(FLT_MAX, FLT_MAX, FLT_MAX, 0.0f);
+        math::Vector4 bbMax = math::Vector4(-FLT_MAX, -FLT_MAX, -FLT_MAX, 0.0f);
+        for (const tfPrimitives &primitive : mesh.m_pPrimitives)
+        {
+            bbMin = math::minPerElem(bbMin, primitive.m_center - primitive.m_radius);
+            bbMax = math::maxPerElem(bbMax, primitive.m_center + primitive.m_radius);
+        }
+
+        m_nodeIndex.push_back(i);
+        m_localCenter.push_back((bbMax + bbMin) * 0.5f);
+        m_localExtent.push_back((bbMax - bbMin) * 0.5f);
+        m_alwaysVisible.push_back(node.skinIndex >= 0 || mesh.m_pPrimitives.empty());
+        m_skinIndex.push_back(node.skinIndex);
+        m_blended.push_back(HasBlendedPrimitive(pGLTFCommon, node.meshIndex));
+        m_primitiveCount.push_back((uint32_t)mesh.m_pPrimitives.size());
+        m_totalPrimitiveCount += (uint32_t)mesh.m_pPrimitives.size();
+    }
+
+    // two boxes per moving node, reserved so that a frame never grows them
+    m_movedCenter.clear();
+    m_movedExtent.clear();
+    m_movedCenter.reserve(2 * m_nodeIndex.size());
+    m_movedExtent.reserve(2 * m_nodeIndex.size());
+
+    const size_t paddedCount = (m_nodeIndex.size() + 3) & ~(size_t)3;
+    m_cx.assign(paddedCount, 0.0f); m_cy.assign(paddedCount, 0.0f); m_cz.assign(paddedCount, 0.0f);
+    m_ex.assign(paddedCount, 0.0f); m_ey.assign(paddedCount, 0.0f); m_ez.assign(paddedCount, 0.0f);
+}
+
+//--------------------------------------------------------------------------------------
+//
+// OnDestroy
+//
+//--------------------------------------------------------------------------------------
+void SceneCuller::OnDestroy()
+{
+    m_pGLTFCommon = NULL;
+    m_nodeIndex.clear();
+    m_localCenter.clear();
+    m_localExtent.clear();
+    m_alwaysVisible.clear();
+    m_skinIndex.clear();
+    m_skinMoved.clear();
+    m_bSkinMoved = false;
+    m_blended.clear();
+    m_primitiveCount.clear();
+    m_totalPrimitiveCount = 0;
+    m_movedCenter.clear();
+    m_movedExtent.clear();
+    m_cx.clear(); m_cy.clear(); m_cz.clear();
+    m_ex.clear(); m_ey.clear(); m_ez.clear();
+}
+
+//--------------------------------------------------------------------------------------
+//
+// TransformBox, transforms an object space box into a world space one (Arvo's method)
+//
+//--------------------------------------------------------------------------------------
+static void TransformBox(const math::Matrix4 &world, const math::Vector4 &center, const math::Vector4 &extent, math::Vector3 *pCenter, math::Vector3 *pExtent)
+{
+    *pCenter = (world * math::Point3(center.getXYZ())).getXYZ();
+    *pExtent =
+        math::absPerElem(world.getCol0().getXYZ()) * extent.getX() +
+        math::absPerElem(world.getCol1().getXYZ()) * extent.getY() +
+        math::absPerElem(world.getCol2().getXYZ()) * extent.getZ();
+}
+
+static bool HasMoved(const Matrix2 &m)
+{
+    const math::Matrix4 current = m.GetCurrent();
+    const math::Matrix4 previous = m.GetPrevious();
+    return memcmp(&current, &previous, sizeof(math::Matrix4)) != 0;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// UpdateBounds
+//
+//--------------------------------------------------------------------------------------
+void SceneCuller::UpdateBounds()
+{
+    if (m_pGLTFCommon == NULL || m_pGLTFCommon->m_worldSpaceMats.empty())
+        return;
+
+    // a skinned mesh moves when any of its joints does
+    std::fill(m_skinMoved.begin(), m_skinMoved.end(), 0);
+    for (auto &skin : m_pGLTFCommon->m_worldSpaceSkeletonMats)
+    {
+        if (skin.first >= 0 && skin.first < (int)m_skinMoved.size())
+            m_skinMoved[skin.first] = std::any_of(skin.second.begin(), skin.second.end(), HasMoved);
+    }
+
+    m_movedCenter.clear();
+    m_movedExtent.clear();
+    m_bSkinMoved = false;
+
+    for (size_t n = 0; n < m_nodeIndex.size(); n++)
+    {
+        const Matrix2 &world = m_pGLTFCommon->m_worldSpaceMats[m_nodeIndex[n]];
+
+        math::Vector3 center, extent;
+        TransformBox(world.GetCurrent(), m_localCenter[n], m_localExtent[n], &center, &extent);
+
+        m_cx[n] = center.getX(); m_cy[n] = center.getY(); m_cz[n] = center.getZ();
+        m_ex[n] = extent.getX(); m_ey[n] = extent.getY(); m_ez[n] = extent.getZ();
+
+        if (m_skinIndex[n] >= 0)
+        {
+            // the joints can carry the mesh anywhere (root motion), no box bounds it so every view has to assume it changed
+            const bool bSkinMoved = m_skinIndex[n] < (int)m_skinMoved.size() && m_skinMoved[m_skinIndex[n]];
+            m_bSkinMoved = m_bSkinMoved || bSkinMoved || HasMoved(world);
+        }
+        else if (HasMoved(world))
+        {
+            math::Vector3 previousCenter, previousExtent;
+            TransformBox(world.GetPrevious(), m_localCenter[n], m_localExtent[n], &previousCenter, &previousExtent);
+
+            m_movedCenter.push_back(previousCenter);
+            m_movedExtent.push_back(previousExtent);
+            m_movedCenter.push_back(center);
+            m_movedExtent.push_back(extent);
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------
+//
+// ExtractPlanes, from the clip matrix (Gribb/Hartmann), clip space depth goes from 0 to 1
+//
+//--------------------------------------------------------------------------------------
+static void ExtractPlanes(const math::Matrix4 &viewProj, math::Vector4 planes[6])
+{
+    const math::Vector4 r0 = viewProj.getRow(0);
+    const math::Vector4 r1 = viewProj.getRow(1);
+    const math::Vector4 r2 = viewProj.getRow(2);
+    const math::Vector4 r3 = viewProj.getRow(3);
+    planes[0] = r3 + r0;
+    planes[1] = r3 - r0;
+    planes[2] = r3 + r1;
+    planes[3] = r3 - r1;
+    planes[4] = r2;
+    planes[5] = r3 - r2;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// HasMovedNodesInside
+//
+//--------------------------------------------------------------------------------------
+bool SceneCuller::HasMovedNodesInside(const math::Matrix4 &viewProj) const
+{
+    if (m_bSkinMoved)
+        return true;
+
+    if (m_movedCenter.empty())
+        return false;
+
+    math::Vector4 planes[6];
+    ExtractPlanes(viewProj, planes);
+
+    for (size_t i = 0; i < m_movedCenter.size(); i++)
+    {
+        bool bOutside = false;
+        for (int p = 0; p < 6 && !bOutside; p++)
+        {
+            const math::Vector3 normal = planes[p].getXYZ();
+            const float d = math::dot(normal, m_movedCenter[i]) + planes[p].getW();
+            const float r = math::dot(math::absPerElem(normal), m_movedExtent[i]);
+            bOutside = d + r < 0.0f;
+        }
+
+        if (!bOutside)
+            return true;
+    }
+
+    return false;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// Cull, tests the world space boxes against the 6 planes of the frustum
+//
+//--------------------------------------------------------------------------------------
+uint32_t SceneCuller::Cull(const math::Matrix4 &viewProj, NodeMask *pVisible, uint32_t *pPrimitiveCount) const
+{
+    // nodes without a mesh are never drawn, leave them visible so the mask can be applied blindly
+    pVisible->assign(m_pGLTFCommon ? m_pGLTFCommon->m_nodes.size() : 0, 1);
+    if (pPrimitiveCount)
+        *pPrimitiveCount = 0;
+    if (m_nodeIndex.empty())
+        return 0;
+
+    math::Vector4 planes[6];
+    ExtractPlanes(viewProj, planes);
+
+    __m128 px[6], py[6], pz[6], pw[6], ax[6], ay[6], az[6];
+    for (int p = 0; p < 6; p++)
+    {
+        px[p] = _mm_set1_ps(planes[p].getX());
+        py[p] = _mm_set1_ps(planes[p].getY());
+        pz[p] = _mm_set1_ps(planes[p].getZ());
+        pw[p] = _mm_set1_ps(planes[p].getW());
+        ax[p] = _mm_set1_ps(fabsf(planes[p].getX()));
+        ay[p] = _mm_set1_ps(fabsf(planes[p].getY()));
+        az[p] = _mm_set1_ps(fabsf(planes[p].getZ()));
+    }
+
+    const __m128 zero = _mm_setzero_ps();
+    uint32_t visibleCount = 0;
+    uint32_t primitiveCount = 0;
+    for (size_t n = 0; n < m_nodeIndex.size(); n += 4)
+    {
+        const __m128 cx = _mm_loadu_ps(&m_cx[n]), cy = _mm_loadu_ps(&m_cy[n]), cz = _mm_loadu_ps(&m_cz[n]);
+        const __m128 ex = _mm_loadu_ps(&m_ex[n]), ey = _mm_loadu_ps(&m_ey[n]), ez = _mm_loadu_ps(&m_ez[n]);
+
+        // a box is outside if it is fully behind any of the planes: dot(plane, center) + dot(abs(plane), extent) < 0
+        __m128 outside = _mm_setzero_ps();
+        for (int p = 0; p < 6; p++)
+        {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[p], cx), _mm_mul_ps(py[p], cy)), _mm_add_ps(_mm_mul_ps(pz[p], cz), pw[p]));
+            __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax[p], ex), _mm_mul_ps(ay[p], ey)), _mm_mul_ps(az[p], ez));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(d, r), zero));
+        }
+
+        const int outsideBits = _mm_movemask_ps(outside);
+        const size_t last = std::min(n + 4, m_nodeIndex.size());
+        for (size_t i = n; i < last; i++)
+        {
+            const bool bVisible = m_alwaysVisible[i] || ((outsideBits & (1 << (i - n))) == 0);
+            (*pVisible)[m_nodeIndex[i]] = bVisible;
+            visibleCount += bVisible;
+            primitiveCount += bVisible ? m_primitiveCount[i] : 0;
+        }
+    }
+
+    if (pPrimitiveCount)
+        *pPrimitiveCount = primitiveCount;
+    return visibleCount;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// CullOccluded
+//
+//--------------------------------------------------------------------------------------
+uint32_t SceneCuller::CullOccluded(const DepthPyramid &pyramid, NodeMask *pVisible) const
+{
+    if (!pyramid.IsValid())
+        return 0;
+
+    uint32_t occludedCount = 0;
+    for (size_t i = 0; i < m_nodeIndex.size(); i++)
+    {
+        uint8_t &bVisible = (*pVisible)[m_nodeIndex[i]];
+        if (!bVisible || m_alwaysVisible[i])
+            continue;
+
+        if (pyramid.IsOccluded(math::Vector3(m_cx[i], m_cy[i], m_cz[i]), math::Vector3(m_ex[i], m_ey[i], m_ez[i])))
+        {
+            bVisible = 0;
+            occludedCount++;
+        }
+    }
+
+    return occludedCount;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// GetDepthPrepassNodes
+//
+//--------------------------------------------------------------------------------------
+uint32_t SceneCuller::GetDepthPrepassNodes(const NodeMask *pVisible, NodeMask *pPrepass) const
+{
+    if (pVisible)
+        *pPrepass = *pVisible;
+    else
+        pPrepass->assign(m_pGLTFCommon ? m_pGLTFCommon->m_nodes.size() : 0, 1);
+
+    uint32_t prepassCount = 0;
+    for (size_t i = 0; i < m_nodeIndex.size(); i++)
+    {
+        uint8_t &bPrepass = (*pPrepass)[m_nodeIndex[i]];
+        if (m_blended[i])
+            bPrepass = 0;
+        prepassCount += bPrepass != 0;
+    }
+
+    return prepassCount;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// ScopedNodeVisibility
+//
+//--------------------------------------------------------------------------------------
+ScopedNodeVisibility::ScopedNodeVisibility(GLTFCommon *pGLTFCommon, const NodeMask *pVisible, FrameArena *pArena)
+    : m_pGLTFCommon(pGLTFCommon)
+    , m_hidden(FrameAllocator<std::pair<int, int>>(pArena))
+{
+    if (pGLTFCommon == NULL || pVisible == NULL)
+        return;
+
+    const size_t count = std::min(pVisible->size(), pGLTFCommon->m_nodes.size());
+    for (size_t i = 0; i < count; i++)
+    {
+        tfNode &node = pGLTFCommon->m_nodes[i];
+        if ((*pVisible)[i] == 0 && node.meshIndex >= 0)
+        {
+            m_hidden.push_back({ (int)i, node.meshIndex });
+            node.meshIndex = -1;
+        }
+    }
+}
+
+ScopedNodeVisibility::~ScopedNodeVisibility()
+{
+    for (const auto &hidden : m_hidden)
+        m_pGLTFCommon->m_nodes[hidden.first].meshIndex = hidden.second;
+}
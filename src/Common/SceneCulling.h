@@ -0,0 +1,102 @@
+// AMD glTFSample sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <windows.h>
+#include <vector>
+#include <stdint.h>
+
+#include "../../libs/vectormath/vectormath.hpp"
+#include "GLTF/GltfCommon.h"
+#include "FrameArena.h"
+#include "OcclusionCulling.h"
+
+// One byte per node of the glTF, non zero means the node is visible from the view it was computed for
+typedef std::vector<uint8_t> NodeMask;
+
+//
+// Keeps the world space bounding box of every node with a mesh and culls them against view frustums.
+// The boxes are kept as structure of arrays so the plane tests run on 4 nodes at a time with SSE.
+//
+class SceneCuller
+{
+public:
+    void OnCreate(const GLTFCommon *pGLTFCommon);
+    void OnDestroy();
+
+    // recomputes the world space boxes from the current world matrices, call it after TransformScene
+    void UpdateBounds();
+
+    // fills pVisible for all the nodes, returns how many nodes with a mesh survived and optionally how many primitives they have
+    uint32_t Cull(const math::Matrix4 &viewProj, NodeMask *pVisible, uint32_t *pPrimitiveCount = NULL) const;
+
+    // hides the visible nodes that are behind the depth of the pyramid, returns how many got hidden
+    uint32_t CullOccluded(const DepthPyramid &pyramid, NodeMask *pVisible) const;
+
+    // fills pPrepass with the visible nodes (all of them if pVisible is NULL) that can go in a depth prepass,
+    // that is the ones without blended primitives, returns how many there are
+    uint32_t GetDepthPrepassNodes(const NodeMask *pVisible, NodeMask *pPrepass) const;
+
+    // true if a node that moved since the last frame overlaps the frustum, either where it was or where it is now,
+    // always true when a skinned mesh moved since its bind pose box doesn't bound it
+    bool HasMovedNodesInside(const math::Matrix4 &viewProj) const;
+
+    uint32_t GetCullableCount() const { return (uint32_t)m_nodeIndex.size(); }
+    uint32_t GetPrimitiveCount() const { return m_totalPrimitiveCount; }
+    uint32_t GetMovedCount() const { return (uint32_t)m_movedCenter.size() / 2; }
+
+private:
+    const GLTFCommon       *m_pGLTFCommon = NULL;
+
+    // object space box of each node with a mesh (the union of its primitives)
+    std::vector<int>            m_nodeIndex;
+    std::vector<math::Vector4>  m_localCenter;
+    std::vector<math::Vector4>  m_localExtent;
+    std::vector<uint8_t>        m_alwaysVisible;    // skinned nodes, their bind pose box doesn't bound the animated mesh
+    std::vector<int>            m_skinIndex;
+    std::vector<uint8_t>        m_skinMoved;        // per skin, whether any of its joints moved this frame
+    std::vector<uint8_t>        m_blended;          // has a primitive with a BLEND material, it can't write depth ahead of the shading
+    std::vector<uint32_t>       m_primitiveCount;   // one draw per primitive
+    uint32_t                    m_totalPrimitiveCount = 0;
+
+    // world space boxes, structure of arrays padded to a multiple of 4
+    std::vector<float>          m_cx, m_cy, m_cz;
+    std::vector<float>          m_ex, m_ey, m_ez;
+
+    // previous and current world space boxes of the nodes that moved this frame
+    std::vector<math::Vector3>  m_movedCenter;
+    std::vector<math::Vector3>  m_movedExtent;
+    bool                        m_bSkinMoved = false;
+};
+
+//
+// Hides the nodes that aren't visible from the glTF passes for the duration of the scope. The passes skip the nodes
+// without a mesh when building their draws, so we clear the mesh index of the culled nodes and restore it afterwards.
+//
+class ScopedNodeVisibility
+{
+public:
+    ScopedNodeVisibility(GLTFCommon *pGLTFCommon, const NodeMask *pVisible, FrameArena *pArena = NULL);
+    ~ScopedNodeVisibility();
+
+private:
+    GLTFCommon                 *m_pGLTFCommon;
+    FrameVector<std::pair<int, int>> m_hidden;   // node index, mesh index
+};
@@ -0,0 +1,249 @@
+// AMD glTFSample sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "SceneGraphTransformer.h"
+#include "WorkerPool.h"
+#include "TraceRecorder.h"
+
+#include <algorithm>
+
+// the previous matrix of a node is the current one of the last frame, so after a change it takes two frames
+// for the motion vectors of a static node to go back to zero
+static const uint32_t FramesToSettle = 2;
+
+// below this many nodes a level is cheaper to evaluate on the calling thread
+static const uint32_t MinNodesPerTask = 512;
+
+//--------------------------------------------------------------------------------------
+//
+// OnCreate
+//
+//--------------------------------------------------------------------------------------
+void SceneGraphTransformer::OnCreate(GLTFCommon *pGLTFCommon, int sceneIndex, WorkerPool *pWorkerPool)
+{
+    m_pGLTFCommon = pGLTFCommon;
+    m_pWorkerPool = pWorkerPool;
+
+    const std::vector<tfNode> &nodes = pGLTFCommon->m_nodes;
+    if (pGLTFCommon->m_worldSpaceMats.size() != nodes.size())
+        pGLTFCommon->m_worldSpaceMats.resize(nodes.size());
+
+    // nodes targeted by any of the animation channels
+    std::vector<uint8_t> animated(nodes.size(), 0);
+    for (const tfAnimation &animation : pGLTFCommon->m_animations)
+    {
+        for (const auto &channel : animation.m_channels)
+            animated[channel.first] = 1;
+    }
+
+    // breadth first walk, it sorts the nodes by depth
+    m_allNodes = FlatHierarchy();
+    m_animatedNodes = FlatHierarchy();
+
+    std::vector<int> level = pGLTFCommon->m_scenes[sceneIndex].m_nodes;
+    std::vector<int> levelParents(level.size(), -1);
+    while (!level.empty())
+    {
+        m_allNodes.levelOffsets.push_back((uint32_t)m_allNodes.nodes.size());
+        m_animatedNodes.levelOffsets.push_back((uint32_t)m_animatedNodes.nodes.size());
+
+        std::vector<int> nextLevel, nextLevelParents;
+        for (size_t i = 0; i < level.size(); i++)
+        {
+            const int nodeIdx = level[i];
+            const int parentIdx = levelParents[i];
+
+            // animation propagates down the hierarchy
+            if (parentIdx >= 0 && animated[parentIdx])
+                animated[nodeIdx] = 1;
+
+            m_allNodes.nodes.push_back(nodeIdx);
+            m_allNodes.parents.push_back(parentIdx);
+            if (animated[nodeIdx])
+            {
+                m_animatedNodes.nodes.push_back(nodeIdx);
+                m_animatedNodes.parents.push_back(parentIdx);
+            }
+
+            for (int child : nodes[nodeIdx].m_children)
+            {
+                nextLevel.push_back(child);
+                nextLevelParents.push_back(nodeIdx);
+            }
+        }
+
+        level.swap(nextLevel);
+        levelParents.swap(nextLevelParents);
+    }
+    m_allNodes.levelOffsets.push_back((uint32_t)m_allNodes.nodes.size());
+    m_animatedNodes.levelOffsets.push_back((uint32_t)m_animatedNodes.nodes.size());
+
+    // the palette of a skin only changes if one of its joints moves
+    m_animatedSkins.clear();
+    for (uint32_t i = 0; i < pGLTFCommon->m_skins.size(); i++)
+    {
+        const std::vector<int> &joints = pGLTFCommon->m_skins[i].m_jointsNodeIdx;
+        if (std::any_of(joints.begin(), joints.end(), [&animated](int joint) { return animated[joint] != 0; }))
+            m_animatedSkins.push_back(i);
+    }
+
+    m_world = math::Matrix4::identity();
+    Invalidate();
+}
+
+//--------------------------------------------------------------------------------------
+//
+// OnDestroy
+//
+//--------------------------------------------------------------------------------------
+void SceneGraphTransformer::OnDestroy()
+{
+    m_pGLTFCommon = NULL;
+    m_pWorkerPool = NULL;
+    m_allNodes = FlatHierarchy();
+    m_animatedNodes = FlatHierarchy();
+    m_animatedSkins.clear();
+}
+
+//--------------------------------------------------------------------------------------
+//
+// Invalidate
+//
+//--------------------------------------------------------------------------------------
+void SceneGraphTransformer::Invalidate()
+{
+    m_settleFrames = FramesToSettle;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// TransformScene
+//
+//--------------------------------------------------------------------------------------
+void SceneGraphTransformer::TransformScene(const math::Matrix4 &world)
+{
+    if (m_pGLTFCommon == NULL)
+        return;
+
+    TraceScope traceScope("TransformScene");
+
+    // moving the whole scene moves the static nodes too
+    for (int i = 0; i < 4; i++)
+    {
+        if (math::lengthSqr(world.getCol(i) - m_world.getCol(i)) != 0.0f)
+        {
+            m_world = world;
+            Invalidate();
+            break;
+        }
+    }
+
+    const bool bSettling = m_settleFrames > 0;
+    if (bSettling)
+    {
+        Evaluate(m_allNodes, world);
+        m_settleFrames--;
+    }
+    else
+    {
+        Evaluate(m_animatedNodes, world);
+    }
+
+    UpdateSkins(bSettling);
+}
+
+//--------------------------------------------------------------------------------------
+//
+// UpdateSkins, skinning matrices are the joints' world matrices times the inverse bind matrices
+//
+//--------------------------------------------------------------------------------------
+void SceneGraphTransformer::UpdateSkins(bool bAllSkins)
+{
+    const uint32_t skinCount = bAllSkins ? (uint32_t)m_pGLTFCommon->m_skins.size() : (uint32_t)m_animatedSkins.size();
+
+    auto updateSkin = [&](uint32_t task)
+    {
+        const uint32_t skinIndex = bAllSkins ? task : m_animatedSkins[task];
+        const tfSkins &skin = m_pGLTFCommon->m_skins[skinIndex];
+        const math::Matrix4 *pInverseBindMats = (const math::Matrix4 *)skin.m_InverseBindMatrices.m_data;
+
+        std::vector<Matrix2> &skinningMats = m_pGLTFCommon->m_worldSpaceSkeletonMats.at(skinIndex);
+        for (int j = 0; j < skin.m_InverseBindMatrices.m_count; j++)
+        {
+            skinningMats[j].Set(m_pGLTFCommon->m_worldSpaceMats[skin.m_jointsNodeIdx[j]].GetCurrent() * pInverseBindMats[j]);
+        }
+    };
+
+    // the palettes are independent from each other, a crowd of skinned characters is worth spreading
+    if (m_pWorkerPool != NULL && skinCount >= 4)
+    {
+        m_pWorkerPool->ParallelFor(skinCount, updateSkin);
+    }
+    else
+    {
+        for (uint32_t i = 0; i < skinCount; i++)
+            updateSkin(i);
+    }
+
+    m_updatedSkinCount = skinCount;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// Evaluate, computes the world matrices level by level
+//
+//--------------------------------------------------------------------------------------
+void SceneGraphTransformer::Evaluate(const FlatHierarchy &hierarchy, const math::Matrix4 &world)
+{
+    std::vector<Matrix2> &worldSpaceMats = m_pGLTFCommon->m_worldSpaceMats;
+    const std::vector<math::Matrix4> &animatedMats = m_pGLTFCommon->m_animatedMats;
+
+    auto evaluateRange = [&](uint32_t first, uint32_t last)
+    {
+        for (uint32_t i = first; i < last; i++)
+        {
+            const int nodeIdx = hierarchy.nodes[i];
+            const int parentIdx = hierarchy.parents[i];
+            const math::Matrix4 &parent = (parentIdx < 0) ? world : worldSpaceMats[parentIdx].GetCurrent();
+            worldSpaceMats[nodeIdx].Set(parent * animatedMats[nodeIdx]);
+        }
+    };
+
+    for (size_t level = 0; level + 1 < hierarchy.levelOffsets.size(); level++)
+    {
+        const uint32_t first = hierarchy.levelOffsets[level];
+        const uint32_t count = hierarchy.levelOffsets[level + 1] - first;
+
+        const uint32_t taskCount = (m_pWorkerPool != NULL) ? std::min(m_pWorkerPool->GetThreadCount(), count / MinNodesPerTask) : 0;
+        if (taskCount <= 1)
+        {
+            evaluateRange(first, first + count);
+        }
+        else
+        {
+            m_pWorkerPool->ParallelFor(taskCount, [&](uint32_t task)
+            {
+                evaluateRange(first + (count * task) / taskCount, first + (count * (task + 1)) / taskCount);
+            });
+        }
+    }
+
+    m_evaluatedCount = (uint32_t)hierarchy.nodes.size();
+}
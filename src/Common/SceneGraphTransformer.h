@@ -0,0 +1,74 @@
+// AMD glTFSample sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+#include "../../libs/vectormath/vectormath.hpp"
+#include "GLTF/GltfCommon.h"
+
+class WorkerPool;
+
+//
+// Replacement for GLTFCommon::TransformScene. The node hierarchy is flattened once into an array sorted by depth,
+// so each level only depends on the previous one and can be spread across the worker threads. Nodes that are not
+// animated and have no animated ancestor are only evaluated until their previous and current matrices agree.
+//
+class SceneGraphTransformer
+{
+public:
+    void OnCreate(GLTFCommon *pGLTFCommon, int sceneIndex, WorkerPool *pWorkerPool);
+    void OnDestroy();
+
+    // fills m_worldSpaceMats and m_worldSpaceSkeletonMats, same results as GLTFCommon::TransformScene
+    void TransformScene(const math::Matrix4 &world);
+
+    // call it after changing the local matrix of a node that isn't animated
+    void Invalidate();
+
+    uint32_t GetNodeCount() const { return (uint32_t)m_allNodes.size(); }
+    uint32_t GetEvaluatedNodeCount() const { return m_evaluatedCount; }
+    uint32_t GetUpdatedSkinCount() const { return m_updatedSkinCount; }
+
+private:
+    // nodes sorted by depth, the parents of the nodes of a level are all in the previous levels
+    struct FlatHierarchy
+    {
+        std::vector<int>        nodes;
+        std::vector<int>        parents;        // node index of the parent, -1 for the roots of the scene
+        std::vector<uint32_t>   levelOffsets;   // first node of each level plus one past the end
+    };
+
+    void Evaluate(const FlatHierarchy &hierarchy, const math::Matrix4 &world);
+    void UpdateSkins(bool bAllSkins);
+
+    GLTFCommon             *m_pGLTFCommon = NULL;
+    WorkerPool             *m_pWorkerPool = NULL;
+
+    FlatHierarchy           m_allNodes;
+    FlatHierarchy           m_animatedNodes;    // the nodes with an animated ancestor (or animated themselves)
+    std::vector<uint32_t>   m_animatedSkins;    // skins with at least one animated joint
+
+    math::Matrix4           m_world;
+    uint32_t                m_settleFrames = 0; // frames left until all the nodes need to be evaluated again
+    uint32_t                m_evaluatedCount = 0;
+    uint32_t                m_updatedSkinCount = 0;
+};
@@ -0,0 +1,402 @@
+// AMD glTFSample sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "ScenePools.h"
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+
+#include "Misc/Misc.h"
+
+// alignment of the buffers suballocated from a StaticBufferPool
+static const uint64_t StaticBufferAlignment = 256;
+
+// smallest pool handed out, so that scenes with next to no geometry still fit what the passes add
+static const uint64_t MinScenePoolSize = 1024 * 1024;
+
+// adds the slack to a size and clamps it to what a pool can be, StaticBufferPool sizes are 32 bit
+static uint32_t GetPoolSizeWithSlack(uint64_t size)
+{
+    uint64_t poolSize = size + size / 8;
+    poolSize = poolSize < MinScenePoolSize ? MinScenePoolSize : poolSize;
+
+    const uint64_t maxPoolSize = UINT32_MAX & ~(StaticBufferAlignment - 1);
+    return (uint32_t)(poolSize > maxPoolSize ? maxPoolSize : poolSize);
+}
+
+static uint32_t GetComponentSize(int componentType)
+{
+    switch (componentType)
+    {
+    case 5120: // BYTE
+    case 5121: // UNSIGNED_BYTE
+        return 1;
+    case 5122: // SHORT
+    case 5123: // UNSIGNED_SHORT
+        return 2;
+    default:   // UNSIGNED_INT, FLOAT
+        return 4;
+    }
+}
+
+static uint32_t GetComponentCount(const std::string &type)
+{
+    if (type == "VEC2") return 2;
+    if (type == "VEC3") return 3;
+    if (type == "VEC4") return 4;
+    if (type == "MAT2") return 4;
+    if (type == "MAT3") return 9;
+    if (type == "MAT4") return 16;
+    return 1;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// GetSceneGeometrySize
+//
+//--------------------------------------------------------------------------------------
+uint64_t GetSceneGeometrySize(const GLTFCommon *pGLTFCommon)
+{
+    const json &j3 = pGLTFCommon->j3;
+    if (j3.find("meshes") == j3.end() || j3.find("accessors") == j3.end())
+        return 0;
+
+    // the passes share the streams of an accessor, so each one is counted once
+    const json &accessors = j3["accessors"];
+    std::vector<uint8_t> usage(accessors.size(), 0);
+    const uint8_t indexUsage = 1, vertexUsage = 2;
+    for (const json &mesh : j3["meshes"])
+    {
+        for (const json &primitive : mesh["primitives"])
+        {
+            const int indices = primitive.value("indices", -1);
+            if (indices >= 0 && indices < (int)usage.size())
+                usage[indices] |= indexUsage;
+
+            if (primitive.find("attributes") == primitive.end())
+                continue;
+            for (const json &attribute : primitive["attributes"])
+            {
+                const int index = attribute.get<int>();
+                if (index >= 0 && index < (int)usage.size())
+                    usage[index] |= vertexUsage;
+            }
+        }
+    }
+
+    uint64_t size = 0;
+    for (size_t i = 0; i < usage.size(); i++)
+    {
+        if (usage[i] == 0)
+            continue;
+
+        const json &accessor = accessors[i];
+        uint64_t stride = GetComponentSize(accessor.value("componentType", 5126)) * GetComponentCount(accessor.value("type", "SCALAR"));
+        if (usage[i] & indexUsage)
+            stride = stride < 2 ? 2 : stride;
+
+        const uint64_t streamSize = accessor.value("count", 0u) * stride;
+        size += (streamSize + StaticBufferAlignment - 1) & ~(StaticBufferAlignment - 1);
+    }
+
+    return size;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// GetSceneGeometryPoolSize
+//
+//--------------------------------------------------------------------------------------
+uint32_t GetSceneGeometryPoolSize(const GLTFCommon *pGLTFCommon)
+{
+    return GetPoolSizeWithSlack(GetSceneGeometrySize(pGLTFCommon));
+}
+
+//--------------------------------------------------------------------------------------
+//
+// ScenePoolHistory::Load
+//
+//--------------------------------------------------------------------------------------
+void ScenePoolHistory::Load(const std::string &filename)
+{
+    m_filename = filename;
+    m_marks = json::object();
+
+    std::ifstream f(m_filename);
+    if (!f)
+        return;
+
+    try
+    {
+        f >> m_marks;
+    }
+    catch (const json::parse_error &)
+    {
+        Trace(format("Error parsing %s, the scene pools are sized from the glTF only\n", m_filename.c_str()));
+    }
+
+    if (!m_marks.is_object())
+        m_marks = json::object();
+}
+
+//--------------------------------------------------------------------------------------
+//
+// ScenePoolHistory::GetPoolSize
+//
+//--------------------------------------------------------------------------------------
+uint32_t ScenePoolHistory::GetPoolSize(const GLTFCommon *pGLTFCommon, uint32_t estimate) const
+{
+    const uint64_t mark = m_marks.value(pGLTFCommon->m_path, 0ull);
+    const uint32_t poolSize = GetPoolSizeWithSlack(mark);
+    return mark != 0 && poolSize > estimate ? poolSize : estimate;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// ScenePoolHistory::Record
+//
+//--------------------------------------------------------------------------------------
+void ScenePoolHistory::Record(const GLTFCommon *pGLTFCommon, uint32_t usedSize, uint32_t poolSize)
+{
+    // a pool that ran out or is about to doesn't tell how much the scene needs, the next run gets twice as much
+    uint64_t mark = usedSize;
+    if (usedSize == UINT32_MAX || usedSize > poolSize - poolSize / 16)
+    {
+        mark = (uint64_t)poolSize * 2;
+        Trace(format("The scene geometry pool of %u KB is too small, the next run will use %llu KB\n", poolSize / 1024, (unsigned long long)(GetPoolSizeWithSlack(mark) / 1024)));
+    }
+    else
+    {
+        Trace(format("Scene geometry pool: %u of %u KB used\n", usedSize / 1024, poolSize / 1024));
+    }
+
+    if (m_marks.value(pGLTFCommon->m_path, 0ull) == mark)
+        return;
+
+    m_marks[pGLTFCommon->m_path] = mark;
+
+    std::ofstream f(m_filename);
+    if (f)
+        f << m_marks.dump(4);
+    else
+        Trace(format("Could not write %s\n", m_filename.c_str()));
+}
+
+static uint32_t ReadBigEndian16(const uint8_t *p) { return (p[0] << 8) | p[1]; }
+static uint32_t ReadBigEndian32(const uint8_t *p) { return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]; }
+static uint32_t ReadLittleEndian32(const uint8_t *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24); }
+
+// bytes per pixel of the DXGI formats the DDS files of the samples use, the block compressed ones are averaged
+static float GetDXGIFormatPixelSize(uint32_t format)
+{
+    if (format >= 1 && format <= 4) return 16.0f;                                       // R32G32B32A32
+    if (format >= 10 && format <= 14) return 8.0f;                                      // R16G16B16A16
+    if ((format >= 70 && format <= 72) || (format >= 79 && format <= 81)) return 0.5f;  // BC1, BC4
+    if ((format >= 73 && format <= 78) || (format >= 82 && format <= 84) || (format >= 94 && format <= 99)) return 1.0f; // BC2, BC3, BC5, BC6H, BC7
+    return 4.0f;
+}
+
+//
+// Where the bytes of an image come from, either its own file or a buffer view of the glTF (as in the .glb files)
+//
+class ImageSource
+{
+public:
+    bool OpenFile(const std::string &filename)
+    {
+        m_file.open(filename, std::ios::binary);
+        return m_file.good();
+    }
+
+    void SetData(const uint8_t *pData, uint64_t size)
+    {
+        m_pData = pData;
+        m_size = size;
+    }
+
+    // reads up to size bytes at offset, returns how many it got
+    size_t Read(uint64_t offset, uint8_t *pDst, size_t size)
+    {
+        if (m_pData != NULL)
+        {
+            if (offset >= m_size)
+                return 0;
+            const size_t count = (size_t)std::min<uint64_t>(size, m_size - offset);
+            memcpy(pDst, m_pData + offset, count);
+            return count;
+        }
+
+        m_file.clear();
+        m_file.seekg(offset);
+        m_file.read((char *)pDst, size);
+        return (size_t)m_file.gcount();
+    }
+
+private:
+    std::ifstream       m_file;
+    const uint8_t      *m_pData = NULL;
+    uint64_t            m_size = 0;
+};
+
+//
+// Reads the dimensions of a DDS, PNG or JPEG image and the size of its pixels once decoded, the rest of the image is
+// left alone. PNGs and JPEGs get decoded to RGBA8.
+//
+static bool GetImageFootprint(ImageSource *pSource, uint32_t *pWidth, uint32_t *pHeight, float *pPixelSize)
+{
+    uint8_t header[148] = {};
+    if (pSource->Read(0, header, sizeof(header)) < 24)
+        return false;
+
+    if (memcmp(header, "DDS ", 4) == 0)
+    {
+        *pHeight = ReadLittleEndian32(header + 12);
+        *pWidth = ReadLittleEndian32(header + 16);
+
+        const uint32_t pixelFormatFlags = ReadLittleEndian32(header + 80);
+        const bool bFourCC = (pixelFormatFlags & 0x4) != 0;
+        if (!bFourCC)
+            *pPixelSize = ReadLittleEndian32(header + 88) / 8.0f;
+        else if (memcmp(header + 84, "DX10", 4) == 0)
+            *pPixelSize = GetDXGIFormatPixelSize(ReadLittleEndian32(header + 128));
+        else if (memcmp(header + 84, "DXT1", 4) == 0 || memcmp(header + 84, "ATI1", 4) == 0 || memcmp(header + 84, "BC4U", 4) == 0)
+            *pPixelSize = 0.5f;
+        else
+            *pPixelSize = 1.0f;
+        return true;
+    }
+
+    *pPixelSize = 4.0f;
+
+    if (memcmp(header, "\x89PNG", 4) == 0)
+    {
+        *pWidth = ReadBigEndian32(header + 16);
+        *pHeight = ReadBigEndian32(header + 20);
+        return true;
+    }
+
+    if (header[0] == 0xFF && header[1] == 0xD8)
+    {
+        // walk the segments up to the start of frame one, it may come after a large thumbnail
+        uint64_t offset = 2;
+        for (;;)
+        {
+            uint8_t segment[9];
+            const size_t segmentSize = pSource->Read(offset, segment, sizeof(segment));
+            if (segmentSize < 4 || segment[0] != 0xFF)
+                return false;
+
+            const uint8_t marker = segment[1];
+            const bool bStartOfFrame = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+            if (bStartOfFrame)
+            {
+                if (segmentSize < 9)
+                    return false;
+                *pHeight = ReadBigEndian16(segment + 5);
+                *pWidth = ReadBigEndian16(segment + 7);
+                return true;
+            }
+
+            offset += 2 + ReadBigEndian16(segment + 2);
+        }
+    }
+
+    return false;
+}
+
+//
+// Points the source at the image, its file or the bytes of its buffer view, false if it can't be found
+//
+static bool OpenImage(const GLTFCommon *pGLTFCommon, const json &image, ImageSource *pSource)
+{
+    if (image.find("uri") != image.end())
+        return pSource->OpenFile(pGLTFCommon->m_path + image["uri"].get<std::string>());
+
+    const json &j3 = pGLTFCommon->j3;
+    const int bufferViewIndex = image.value("bufferView", -1);
+    if (bufferViewIndex < 0 || j3.find("bufferViews") == j3.end() || bufferViewIndex >= (int)j3["bufferViews"].size())
+        return false;
+
+    const json &bufferView = j3["bufferViews"][bufferViewIndex];
+    const int bufferIndex = bufferView.value("buffer", -1);
+    if (bufferIndex < 0 || bufferIndex >= (int)pGLTFCommon->buffersData.size() || pGLTFCommon->buffersData[bufferIndex] == NULL)
+        return false;
+
+    const uint8_t *pBuffer = (const uint8_t *)pGLTFCommon->buffersData[bufferIndex];
+    pSource->SetData(pBuffer + bufferView.value("byteOffset", 0ull), bufferView.value("byteLength", 0ull));
+    return true;
+}
+
+static uint64_t GetImageUploadSize(const GLTFCommon *pGLTFCommon, const json &image)
+{
+    ImageSource source;
+    if (!OpenImage(pGLTFCommon, image, &source))
+        return 0;
+
+    uint32_t width = 0, height = 0;
+    float pixelSize = 0.0f;
+    if (!GetImageFootprint(&source, &width, &height, &pixelSize))
+        return 0;
+
+    // the mip chain adds a third, plus the padding of the rows and of the mips
+    return (uint64_t)((double)width * height * pixelSize * 4.0 / 3.0) + (uint64_t)height * 256 + 64 * 1024;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// GetLargestTextureUploadSize
+//
+//--------------------------------------------------------------------------------------
+uint64_t GetLargestTextureUploadSize(const GLTFCommon *pGLTFCommon)
+{
+    const json &j3 = pGLTFCommon->j3;
+    if (j3.find("images") == j3.end())
+        return 0;
+
+    uint64_t largestSize = 0;
+    for (const json &image : j3["images"])
+    {
+        const uint64_t size = GetImageUploadSize(pGLTFCommon, image);
+        largestSize = size > largestSize ? size : largestSize;
+    }
+
+    return largestSize;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// GetSceneTextureSize
+//
+//--------------------------------------------------------------------------------------
+uint64_t GetSceneTextureSize(const GLTFCommon *pGLTFCommon)
+{
+    const json &j3 = pGLTFCommon->j3;
+    if (j3.find("images") == j3.end())
+        return 0;
+
+    uint64_t size = 0;
+    for (const json &image : j3["images"])
+        size += GetImageUploadSize(pGLTFCommon, image);
+
+    return size;
+}
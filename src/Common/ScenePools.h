@@ -0,0 +1,66 @@
+// AMD glTFSample sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+#include "GLTF/GltfCommon.h"
+
+// Bytes the vertex and index streams of the scene take once uploaded to a StaticBufferPool. Every accessor a primitive
+// references is uploaded once, 8 bit indices get widened to 16 bit and each stream is aligned like the pool does it.
+// This only reads the glTF's JSON so the pool can be sized before anything gets uploaded.
+uint64_t GetSceneGeometrySize(const GLTFCommon *pGLTFCommon);
+
+// Size of the StaticBufferPool the scene's geometry goes in, the above with some slack for the few buffers the passes
+// allocate on their own (the bounding box pass' cube for instance).
+uint32_t GetSceneGeometryPoolSize(const GLTFCommon *pGLTFCommon);
+
+//
+// High-water marks of the scene geometry pools, saved per scene so the next run sizes the pool after what the scene
+// really used when the accessor estimate falls short (alignment, buffers the passes add on their own). Cauldron's
+// pools can't grow, so an undersized pool is only fixed on the next run. Scenes are keyed by their glTF directory,
+// each scene of the sample lives in its own.
+//
+class ScenePoolHistory
+{
+public:
+    void Load(const std::string &filename);
+
+    // the larger of the estimate and the last recorded mark with some slack
+    uint32_t GetPoolSize(const GLTFCommon *pGLTFCommon, uint32_t estimate) const;
+
+    // records how much of its pool the scene used, UINT32_MAX if the pool ran out, and saves the file
+    void Record(const GLTFCommon *pGLTFCommon, uint32_t usedSize, uint32_t poolSize);
+
+private:
+    std::string                 m_filename;
+    json                        m_marks;
+};
+
+// Bytes the largest image of the scene takes in the upload heap with its mip chain, going by its header (read from its
+// file or from its buffer view). Cauldron suballocates the whole mip chain of a texture slice at once, when the heap
+// is full it gets flushed and reused, so the heap only has to be as big as the largest slice no matter how many
+// textures the scene has.
+uint64_t GetLargestTextureUploadSize(const GLTFCommon *pGLTFCommon);
+
+// Same as above for all the images of the scene, roughly the video memory its textures take.
+uint64_t GetSceneTextureSize(const GLTFCommon *pGLTFCommon);
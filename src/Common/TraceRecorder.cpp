@@ -0,0 +1,196 @@
+// AMD glTFSample sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "TraceRecorder.h"
+
+#include <chrono>
+#include <fstream>
+#include <atomic>
+#include <cstdlib>
+
+static uint64_t GetMicroseconds()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// trace viewers expect valid JSON strings
+static std::string Escape(const std::string &str)
+{
+    std::string out;
+    out.reserve(str.size());
+    for (char c : str)
+    {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        if ((unsigned char)c >= 0x20)
+            out += c;
+    }
+    return out;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// Get
+//
+//--------------------------------------------------------------------------------------
+TraceRecorder &TraceRecorder::Get()
+{
+    static TraceRecorder s_recorder;
+    return s_recorder;
+}
+
+TraceRecorder::TraceRecorder()
+{
+    m_origin = GetMicroseconds();
+}
+
+uint64_t TraceRecorder::Now() const
+{
+    return GetMicroseconds() - m_origin;
+}
+
+size_t TraceRecorder::GetEventCount()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_events.size();
+}
+
+//--------------------------------------------------------------------------------------
+//
+// GetThreadId, small numbers read better than the OS ids, 0 is the GPU
+//
+//--------------------------------------------------------------------------------------
+uint32_t TraceRecorder::GetThreadId()
+{
+    static std::atomic<uint32_t> s_nextId(GpuThreadId + 1);
+    thread_local uint32_t t_id = s_nextId++;
+    return t_id;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// AddCpuEvent
+//
+//--------------------------------------------------------------------------------------
+void TraceRecorder::AddCpuEvent(const std::string &name, uint64_t startUs, uint64_t durationUs)
+{
+    if (!m_bEnabled)
+        return;
+
+    const uint32_t threadId = GetThreadId();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_events.size() < MaxEvents)
+        m_events.push_back({ name, startUs, durationUs, threadId });
+}
+
+void TraceRecorder::AddGpuEvent(const std::string &name, uint64_t startUs, uint64_t durationUs)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_events.size() < MaxEvents)
+        m_events.push_back({ name, startUs, durationUs, GpuThreadId });
+}
+
+//--------------------------------------------------------------------------------------
+//
+// OnBeginFrame
+//
+//--------------------------------------------------------------------------------------
+void TraceRecorder::OnBeginFrame()
+{
+    m_frame++;
+    m_frameStarts[m_frame % MaxLatencyFrames] = Now();
+}
+
+//--------------------------------------------------------------------------------------
+//
+// Save
+//
+//--------------------------------------------------------------------------------------
+bool TraceRecorder::Save(const std::string &filename)
+{
+    std::vector<Event> events;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        events.swap(m_events);
+    }
+
+    std::ofstream f(filename);
+    if (!f)
+        return false;
+
+    f << "{\"traceEvents\":[\n";
+    f << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << GpuThreadId << ",\"args\":{\"name\":\"GPU\"}}";
+    for (const Event &event : events)
+    {
+        f << ",\n{\"name\":\"" << Escape(event.name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.threadId
+          << ",\"ts\":" << event.start << ",\"dur\":" << event.duration << "}";
+    }
+    f << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    return f.good();
+}
+
+//--------------------------------------------------------------------------------------
+//
+// SaveOnExit
+//
+//--------------------------------------------------------------------------------------
+void TraceRecorder::SaveOnExit(const std::string &filename)
+{
+    if (m_exitFilename.empty())
+        std::atexit([] { TraceRecorder &recorder = Get(); recorder.Save(recorder.m_exitFilename); });
+
+    m_exitFilename = filename;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// TraceScope
+//
+//--------------------------------------------------------------------------------------
+TraceScope::TraceScope(const char *name)
+{
+    m_bEnabled = TraceRecorder::Get().IsEnabled();
+    if (m_bEnabled)
+    {
+        m_pName = name;
+        m_start = TraceRecorder::Get().Now();
+    }
+}
+
+TraceScope::TraceScope(const std::string &name)
+{
+    m_bEnabled = TraceRecorder::Get().IsEnabled();
+    if (m_bEnabled)
+    {
+        m_name = name;
+        m_start = TraceRecorder::Get().Now();
+    }
+}
+
+TraceScope::~TraceScope()
+{
+    if (m_bEnabled)
+    {
+        TraceRecorder &recorder = TraceRecorder::Get();
+        recorder.AddCpuEvent(m_pName ? std::string(m_pName) : m_name, m_start, recorder.Now() - m_start);
+    }
+}
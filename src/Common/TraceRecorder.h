@@ -0,0 +1,117 @@
+// AMD glTFSample sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <stdint.h>
+
+//
+// Records CPU scopes and GPU timings on a single timeline and writes them in the Chrome trace event format, the
+// file can be opened with chrome://tracing or https://ui.perfetto.dev. Recording is off until SetEnabled(true).
+//
+class TraceRecorder
+{
+public:
+    static TraceRecorder &Get();
+
+    void SetEnabled(bool bEnabled) { m_bEnabled = bEnabled; }
+    bool IsEnabled() const { return m_bEnabled; }
+    size_t GetEventCount();
+
+    // microseconds since the recorder was created
+    uint64_t Now() const;
+
+    void AddCpuEvent(const std::string &name, uint64_t startUs, uint64_t durationUs);
+
+    // call once per frame before recording, it remembers when each frame started so the GPU timings can be placed
+    void OnBeginFrame();
+
+    // the GPU timestamps come back latencyFrames late and only as deltas, they are laid out one after the other
+    // from the start of the frame they belong to. The last entry is the total of the frame.
+    template<class T> void AddGpuTimestamps(const std::vector<T> &timeStamps, uint32_t latencyFrames)
+    {
+        if (!m_bEnabled || timeStamps.empty() || m_frame <= latencyFrames)
+            return;
+
+        uint64_t start = m_frameStarts[(m_frame - latencyFrames) % MaxLatencyFrames];
+        AddGpuEvent("GPU frame", start, (uint64_t)timeStamps.back().m_microseconds);
+        for (size_t i = 0; i + 1 < timeStamps.size(); i++)
+        {
+            const uint64_t duration = (uint64_t)timeStamps[i].m_microseconds;
+            AddGpuEvent(timeStamps[i].m_label, start, duration);
+            start += duration;
+        }
+    }
+
+    // writes everything recorded so far and clears it
+    bool Save(const std::string &filename);
+
+    // for runs that end with exit(), like the benchmark
+    void SaveOnExit(const std::string &filename);
+
+private:
+    struct Event
+    {
+        std::string     name;
+        uint64_t        start;
+        uint64_t        duration;
+        uint32_t        threadId;
+    };
+
+    void AddGpuEvent(const std::string &name, uint64_t startUs, uint64_t durationUs);
+    static uint32_t GetThreadId();
+
+    static const uint32_t   MaxLatencyFrames = 8;
+    static const size_t     MaxEvents = 1024 * 1024;
+    static const uint32_t   GpuThreadId = 0;
+
+    TraceRecorder();
+
+    std::mutex              m_mutex;
+    std::vector<Event>      m_events;
+    std::atomic<bool>       m_bEnabled = false;     // set from the UI thread, read by the workers
+    uint64_t                m_origin;
+
+    uint32_t                m_frame = 0;
+    uint64_t                m_frameStarts[MaxLatencyFrames] = {};
+
+    std::string             m_exitFilename;
+};
+
+//
+// Records the lifetime of the scope as a CPU event
+//
+class TraceScope
+{
+public:
+    TraceScope(const char *name);
+    TraceScope(const std::string &name);
+    ~TraceScope();
+
+private:
+    // the name is only copied into a string when recording, so the scopes cost nothing while it's off
+    const char     *m_pName = NULL;
+    std::string     m_name;
+    uint64_t        m_start = 0;
+    bool            m_bEnabled;
+};
@@ -0,0 +1,177 @@
+// AMD glTFSample sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "TransientResources.h"
+
+#include <algorithm>
+#include <assert.h>
+
+//--------------------------------------------------------------------------------------
+//
+// Reset
+//
+//--------------------------------------------------------------------------------------
+void TransientResourcePlanner::Reset()
+{
+    m_resources.clear();
+    m_passes.clear();
+    m_accesses.clear();
+    m_heapSizes.clear();
+    m_dedicatedSize = 0;
+    m_aliasedSize = 0;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// AddResource
+//
+//--------------------------------------------------------------------------------------
+uint32_t TransientResourcePlanner::AddResource(const char *pName, uint64_t size, bool bPersistent)
+{
+    m_resources.push_back({ pName, size, bPersistent, -1, -1, 0 });
+    return (uint32_t)m_resources.size() - 1;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// AddPass, the passes have to be added in the order they run
+//
+//--------------------------------------------------------------------------------------
+void TransientResourcePlanner::AddPass(const char *pName, const std::vector<uint32_t> &reads, const std::vector<uint32_t> &writes)
+{
+    const uint32_t pass = (uint32_t)m_passes.size();
+    m_passes.push_back(pName);
+
+    for (uint32_t resource : reads)
+        m_accesses.push_back({ pass, resource });
+    for (uint32_t resource : writes)
+        m_accesses.push_back({ pass, resource });
+}
+
+//--------------------------------------------------------------------------------------
+//
+// GetTextureSize
+//
+//--------------------------------------------------------------------------------------
+uint64_t TransientResourcePlanner::GetTextureSize(uint32_t width, uint32_t height, uint32_t mipCount, uint32_t bytesPerPixel)
+{
+    uint64_t size = 0;
+    for (uint32_t mip = 0; mip < mipCount; mip++)
+    {
+        size += (uint64_t)std::max(width >> mip, 1u) * std::max(height >> mip, 1u) * bytesPerPixel;
+    }
+    return size;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// Plan, first fit of the transient resources into heaps, the biggest ones first
+//
+//--------------------------------------------------------------------------------------
+void TransientResourcePlanner::Plan()
+{
+    for (Resource &resource : m_resources)
+    {
+        resource.firstPass = -1;
+        resource.lastPass = -1;
+    }
+
+    for (const auto &access : m_accesses)
+    {
+        assert(access.second < m_resources.size());
+        Resource &resource = m_resources[access.second];
+        const int pass = (int)access.first;
+        resource.firstPass = resource.firstPass < 0 ? pass : std::min(resource.firstPass, pass);
+        resource.lastPass = std::max(resource.lastPass, pass);
+    }
+
+    std::vector<uint32_t> order(m_resources.size());
+    for (uint32_t i = 0; i < (uint32_t)order.size(); i++)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) { return m_resources[a].size > m_resources[b].size; });
+
+    // the resources in each heap, a resource fits in a heap if its lifetime overlaps none of them
+    std::vector<std::vector<uint32_t>> heapResources;
+    m_heapSizes.clear();
+    m_dedicatedSize = 0;
+    for (uint32_t index : order)
+    {
+        Resource &resource = m_resources[index];
+        m_dedicatedSize += resource.size;
+
+        uint32_t heap = (uint32_t)heapResources.size();
+        if (!resource.bPersistent && resource.firstPass >= 0)
+        {
+            for (uint32_t h = 0; h < (uint32_t)heapResources.size() && heap == heapResources.size(); h++)
+            {
+                bool bFits = true;
+                for (uint32_t other : heapResources[h])
+                {
+                    const Resource &o = m_resources[other];
+                    bFits = bFits && !o.bPersistent && o.firstPass >= 0 && (resource.lastPass < o.firstPass || o.lastPass < resource.firstPass);
+                }
+                if (bFits)
+                    heap = h;
+            }
+        }
+
+        if (heap == heapResources.size())
+        {
+            heapResources.emplace_back();
+            m_heapSizes.push_back(0);
+        }
+        heapResources[heap].push_back(index);
+        m_heapSizes[heap] = std::max(m_heapSizes[heap], resource.size);
+        resource.heap = heap;
+    }
+
+    m_aliasedSize = 0;
+    for (uint64_t size : m_heapSizes)
+        m_aliasedSize += size;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// PlanWindowSizeDependentTargets
+//
+//--------------------------------------------------------------------------------------
+void PlanWindowSizeDependentTargets(TransientResourcePlanner *pPlanner, uint32_t width, uint32_t height, uint32_t downsampleMipCount)
+{
+    // sizes from the formats the targets get created with, without the padding and alignment of the driver
+    pPlanner->Reset();
+    const uint32_t depth = pPlanner->AddResource("Depth", TransientResourcePlanner::GetTextureSize(width, height, 1, 4));
+    const uint32_t hdr = pPlanner->AddResource("HDR", TransientResourcePlanner::GetTextureSize(width, height, 1, 8));
+    const uint32_t motionVectors = pPlanner->AddResource("Motion vectors", TransientResourcePlanner::GetTextureSize(width, height, 1, 4));
+    const uint32_t downsample = pPlanner->AddResource("Downsample", TransientResourcePlanner::GetTextureSize(width / 2, height / 2, downsampleMipCount, 8));
+    const uint32_t bloom = pPlanner->AddResource("Bloom blur", TransientResourcePlanner::GetTextureSize(width / 2, height / 2, downsampleMipCount, 8));
+    const uint32_t taa = pPlanner->AddResource("TAA", TransientResourcePlanner::GetTextureSize(width, height, 1, 8));
+    const uint32_t taaHistory = pPlanner->AddResource("TAA history", TransientResourcePlanner::GetTextureSize(width, height, 1, 8), true);
+    const uint32_t magnifier = pPlanner->AddResource("Magnifier output", TransientResourcePlanner::GetTextureSize(width, height, 1, 8));
+
+    // the passes of OnRender with TAA and the magnifier on, that's when the most targets are alive
+    pPlanner->AddPass("PBR Opaque", {}, { depth, hdr, motionVectors });
+    pPlanner->AddPass("Skydome and transparent", { depth }, { hdr, motionVectors });
+    pPlanner->AddPass("Downsample", { hdr }, { downsample });
+    pPlanner->AddPass("Bloom", { downsample }, { bloom, hdr });
+    pPlanner->AddPass("TAA", { hdr, depth, motionVectors, taaHistory }, { taa, taaHistory, hdr });
+    pPlanner->AddPass("Magnifier", { hdr }, { magnifier });
+    pPlanner->AddPass("Tonemapping", { magnifier }, {});
+    pPlanner->Plan();
+}
@@ -0,0 +1,76 @@
+// AMD glTFSample sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+//
+// Describes the frame as a list of passes with the targets they read and write, works out the lifetime of every
+// target (from the first pass touching it to the last one) and packs the transient ones whose lifetimes don't
+// overlap into shared heaps. Persistent targets, the ones read before they are written in a frame like a history
+// buffer, always keep their own memory.
+//
+class TransientResourcePlanner
+{
+public:
+    void Reset();
+
+    // returns the index of the resource, to be used in the passes
+    uint32_t AddResource(const char *pName, uint64_t size, bool bPersistent = false);
+    void AddPass(const char *pName, const std::vector<uint32_t> &reads, const std::vector<uint32_t> &writes);
+
+    // computes the lifetimes and the heap of each resource
+    void Plan();
+
+    // memory needed when every target has its own allocation, and when the transient ones share heaps
+    uint64_t GetDedicatedSize() const { return m_dedicatedSize; }
+    uint64_t GetAliasedSize() const { return m_aliasedSize; }
+    uint32_t GetHeapCount() const { return (uint32_t)m_heapSizes.size(); }
+    uint32_t GetHeap(uint32_t resource) const { return m_resources[resource].heap; }
+
+    // size of a 2D texture with its mip chain
+    static uint64_t GetTextureSize(uint32_t width, uint32_t height, uint32_t mipCount, uint32_t bytesPerPixel);
+
+private:
+    struct Resource
+    {
+        std::string     name;
+        uint64_t        size;
+        bool            bPersistent;
+        int             firstPass;      // -1 if no pass uses it
+        int             lastPass;
+        uint32_t        heap;
+    };
+
+    std::vector<Resource>   m_resources;
+    std::vector<std::string> m_passes;
+    std::vector<std::pair<uint32_t, uint32_t>> m_accesses;  // pass, resource
+
+    std::vector<uint64_t>   m_heapSizes;
+    uint64_t                m_dedicatedSize = 0;
+    uint64_t                m_aliasedSize = 0;
+};
+
+// Declares the window size dependent targets of the renderers and the passes of OnRender that use them, then plans
+// them. The backends only differ in the length of the downsample and bloom chains.
+void PlanWindowSizeDependentTargets(TransientResourcePlanner *pPlanner, uint32_t width, uint32_t height, uint32_t downsampleMipCount);
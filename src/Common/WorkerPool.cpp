@@ -0,0 +1,154 @@
+// AMD glTFSample sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+//--------------------------------------------------------------------------------------
+//
+// OnCreate
+//
+//--------------------------------------------------------------------------------------
+void WorkerPool::OnCreate(uint32_t threadCount)
+{
+    if (threadCount == ~0u)
+    {
+        const uint32_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+        threadCount = hardwareThreads - 1;
+    }
+
+    m_bQuit = false;
+    for (uint32_t i = 0; i < threadCount; i++)
+        m_threads.push_back(std::thread(&WorkerPool::WorkerLoop, this));
+}
+
+//--------------------------------------------------------------------------------------
+//
+// OnDestroy
+//
+//--------------------------------------------------------------------------------------
+void WorkerPool::OnDestroy()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bQuit = true;
+    }
+    m_wakeUp.notify_all();
+
+    for (std::thread &thread : m_threads)
+        thread.join();
+    m_threads.clear();
+}
+
+//--------------------------------------------------------------------------------------
+//
+// ParallelFor
+//
+//--------------------------------------------------------------------------------------
+void WorkerPool::ParallelFor(uint32_t count, const std::function<void(uint32_t)> &task)
+{
+    if (count == 0)
+        return;
+
+    // not worth waking anybody up
+    if (count == 1 || m_threads.empty())
+    {
+        for (uint32_t i = 0; i < count; i++)
+            task(i);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pTask = &task;
+        m_taskCount = count;
+        m_tasksLeft = count;
+        m_nextTask = 0;
+        m_generation++;
+    }
+    m_wakeUp.notify_all();
+
+    const uint32_t completed = RunTasks(&task, count);
+
+    // the workers that joined may still be between their last task and the end of RunTasks, the next call
+    // resets the task counter so it has to wait for them too
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_tasksLeft -= completed;
+    m_done.wait(lock, [this] { return m_tasksLeft == 0 && m_activeWorkers == 0; });
+    m_pTask = NULL;
+    m_taskCount = 0;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// RunTasks, grabs tasks until there are none left and returns how many it ran
+//
+//--------------------------------------------------------------------------------------
+uint32_t WorkerPool::RunTasks(const std::function<void(uint32_t)> *pTask, uint32_t taskCount)
+{
+    uint32_t completed = 0;
+    for (uint32_t i = m_nextTask++; i < taskCount; i = m_nextTask++)
+    {
+        (*pTask)(i);
+        completed++;
+    }
+    return completed;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// WorkerLoop
+//
+//--------------------------------------------------------------------------------------
+void WorkerPool::WorkerLoop()
+{
+    uint64_t generation = 0;
+    for (;;)
+    {
+        const std::function<void(uint32_t)> *pTask;
+        uint32_t taskCount;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeUp.wait(lock, [&] { return m_bQuit || m_generation != generation; });
+            if (m_bQuit)
+                return;
+            generation = m_generation;
+
+            // the call was already over by the time this thread woke up
+            if (m_pTask == NULL)
+                continue;
+
+            pTask = m_pTask;
+            taskCount = m_taskCount;
+            m_activeWorkers++;
+        }
+
+        const uint32_t completed = RunTasks(pTask, taskCount);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_tasksLeft -= completed;
+            m_activeWorkers--;
+            if (m_tasksLeft == 0 && m_activeWorkers == 0)
+                m_done.notify_one();
+        }
+    }
+}
@@ -0,0 +1,64 @@
+// AMD glTFSample sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <stdint.h>
+
+//
+// A small pool of persistent threads for the per frame work that has to finish before the frame goes on
+// (command recording, scene updates). Unlike the AsyncPool used for loading, the calling thread takes part
+// in the work and ParallelFor only returns once all the tasks are done.
+//
+class WorkerPool
+{
+public:
+    // threadCount is the number of extra threads, by default one less than the number of hardware threads
+    void OnCreate(uint32_t threadCount = ~0u);
+    void OnDestroy();
+
+    // number of threads running tasks, the calling thread included
+    uint32_t GetThreadCount() const { return (uint32_t)m_threads.size() + 1; }
+
+    // runs task(i) for all i in [0, count), the tasks must be independent from each other
+    void ParallelFor(uint32_t count, const std::function<void(uint32_t)> &task);
+
+private:
+    void WorkerLoop();
+    uint32_t RunTasks(const std::function<void(uint32_t)> *pTask, uint32_t taskCount);
+
+    std::vector<std::thread>                m_threads;
+    std::mutex                              m_mutex;
+    std::condition_variable                 m_wakeUp;
+    std::condition_variable                 m_done;
+
+    const std::function<void(uint32_t)>    *m_pTask = NULL;
+    uint32_t                                m_taskCount = 0;
+    std::atomic<uint32_t>                   m_nextTask = 0;
+    uint32_t                                m_tasksLeft = 0;
+    uint32_t                                m_activeWorkers = 0;    // workers that joined the current call and haven't left RunTasks yet
+    uint64_t                                m_generation = 0;
+    bool                                    m_bQuit = false;
+};
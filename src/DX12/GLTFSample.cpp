@@ -48,6 +48,7 @@ void GLTFSample::OnParseCommandLine(LPSTR lpCmdLine, uint32_t* pWidth, uint32_t*
     m_isGpuValidationLayerEnabled = false;
     m_activeCamera = 0;
     m_stablePowerState = false;
+    m_traceFilename = "GLTFSample_trace.json";
 
     //read globals
     auto process = [&](json jData)
@@ -62,6 +63,7 @@ void GLTFSample::OnParseCommandLine(LPSTR lpCmdLine, uint32_t* pWidth, uint32_t*
         m_VsyncEnabled = jData.value("vsync", m_VsyncEnabled);
         m_FreesyncHDROptionEnabled = jData.value("FreesyncHDROptionEnabled", m_FreesyncHDROptionEnabled);
         m_bIsBenchmarking = jData.value("benchmark", m_bIsBenchmarking);
+        m_traceFilename = jData.value("traceFile", m_traceFilename);
         m_stablePowerState = jData.value("stablePowerState", m_stablePowerState);
         m_fontSize = jData.value("fontsize", m_fontSize);
     };
@@ -127,6 +129,13 @@ void GLTFSample::OnCreate()
     m_pRenderer = new Renderer();
     m_pRenderer->OnCreate(&m_device, &m_swapChain, m_fontSize);
 
+    // benchmarks record a trace of the whole run, the benchmark ends the app with exit()
+    if (m_bIsBenchmarking)
+    {
+        TraceRecorder::Get().SetEnabled(true);
+        TraceRecorder::Get().SaveOnExit(m_traceFilename);
+    }
+
     // init GUI (non gfx stuff)
     ImGUI_Init((void *)m_windowHwnd);
     m_UIState.Initialize();
@@ -158,6 +167,9 @@ void GLTFSample::OnDestroy()
     //shut down the shader compiler 
     DestroyShaderCache(&m_device);
 
+    m_sceneTransformer.OnDestroy();
+    m_animationSampler.OnDestroy();
+
     if (m_pGltfLoader)
     {
         delete m_pGltfLoader;
@@ -250,6 +262,13 @@ void GLTFSample::LoadScene(int sceneIndex)
         exit(0);
     }
 
+    // flatten the node hierarchy of the scene, the transforms get evaluated in parallel every frame
+    m_sceneTransformer.OnCreate(m_pGltfLoader, 0, m_pRenderer->GetWorkerPool());
+    m_animationSampler.OnCreate(m_pGltfLoader);
+
+    // optional CPU benchmark of the animation sampling, see the BusterDrone scene
+    AnimationSampler::Benchmark(m_pGltfLoader, scene.value("animationBenchmarkIterations", 0u));
+
     // Load the UI settings, and also some defaults cameras and lights, in case the GLTF has none
     {
 #define LOAD(j, key, val) val = j.value(key, val)
@@ -261,6 +280,12 @@ void GLTFSample::LoadScene(int sceneIndex)
         LOAD(scene, "exposure", m_UIState.Exposure);
         LOAD(scene, "iblFactor", m_UIState.IBLFactor);
         LOAD(scene, "emmisiveFactor", m_UIState.EmissiveFactor);
+
+        // the depth prepass only pays off in scenes with a lot of overdraw, so it's off unless the scene asks for it
+        m_UIState.bDepthPrepass = scene.value("depthPrepass", false);
+
+        // scenes with heavy textures can skip their top mips, every level of bias samples a quarter of the texels
+        m_UIState.TextureLodBias = scene.value("textureLodBias", 0.0f);
         LOAD(scene, "skyDomeType", m_UIState.SelectedSkydomeTypeIndex);
 
         // Add a default light in case there are none
@@ -313,6 +338,8 @@ void GLTFSample::LoadScene(int sceneIndex)
 //--------------------------------------------------------------------------------------
 void GLTFSample::OnUpdate()
 {
+    TraceScope traceScope("OnUpdate");
+
     ImGuiIO& io = ImGui::GetIO();
 
     //If the mouse was not used by the GUI then it's for the camera
@@ -342,8 +369,8 @@ void GLTFSample::OnUpdate()
 
     if (m_pGltfLoader)
     {
-        m_pGltfLoader->SetAnimationTime(0, m_time);
-        m_pGltfLoader->TransformScene(0, math::Matrix4::identity());
+        m_animationSampler.SetAnimationTime(m_pGltfLoader, 0, m_time);
+        m_sceneTransformer.TransformScene(math::Matrix4::identity());
     }
 }
 void GLTFSample::HandleInput(const ImGuiIO& io)
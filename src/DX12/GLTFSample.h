@@ -21,6 +21,9 @@
 #include "base/FrameworkWindows.h"
 #include "Renderer.h"
 #include "UI.h"
+#include "SceneGraphTransformer.h"
+#include "AnimationSampler.h"
+#include "TraceRecorder.h"
 
 // This class encapsulates the 'application' and is responsible for handling window events and scene updates (simulation)
 // Rendering and rendering resource management is done by the Renderer class
@@ -51,6 +54,8 @@ private:
 
     GLTFCommon                 *m_pGltfLoader = NULL;
     bool                        m_loadingScene = false;
+    SceneGraphTransformer       m_sceneTransformer;
+    AnimationSampler            m_animationSampler;
 
     Renderer*                   m_pRenderer = NULL;
     UIState                     m_UIState;
@@ -59,6 +64,8 @@ private:
 
     float                       m_time; // Time accumulator in seconds, used for animation.
 
+    std::string                 m_traceFilename;    // where the CPU/GPU trace gets saved
+
     // json config file
     json                        m_jsonConfigFile;
     std::vector<std::string>    m_sceneNames;
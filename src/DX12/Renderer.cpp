@@ -43,23 +43,33 @@ void Renderer::OnCreate(Device* pDevice, SwapChain *pSwapChain, float FontSize)
     m_ResourceViewHeaps.OnCreate(pDevice, cbvDescriptorCount, srvDescriptorCount, uavDescriptorCount, dsvDescriptorCount, rtvDescriptorCount, samplerDescriptorCount);
 
     // Create a commandlist ring for the Direct queue
-    uint32_t commandListsPerBackBuffer = 8;
-    m_CommandListRing.OnCreate(pDevice, backBufferCount, commandListsPerBackBuffer, pDevice->GetGraphicsQueue()->GetDesc());
+    m_CommandListRing.OnCreate(pDevice, backBufferCount, CommandListsPerBackBuffer, pDevice->GetGraphicsQueue()->GetDesc());
+
+    // Threads for recording the command lists
+    m_WorkerPool.OnCreate();
+
+    // Transient containers of the frame being recorded
+    m_FrameArena.OnCreate(256 * 1024);
+    HeapAllocationCounter::InstallHook();
+
+    // the high-water marks of the scene geometry pools, next to the config file
+    m_ScenePoolHistory.Load("GLTFSample_pools.json");
 
     // Create a 'dynamic' constant buffer
     const uint32_t constantBuffersMemSize = 200 * 1024 * 1024;
     m_ConstantBufferRing.OnCreate(pDevice, backBufferCount, constantBuffersMemSize, &m_ResourceViewHeaps);
 
-    // Create a 'static' pool for vertices, indices and constant buffers
-    const uint32_t staticGeometryMemSize = (5 * 128) * 1024 * 1024;
+    // Create a 'static' pool for vertices and indices of the scene independent passes (skydome, widgets, post processes),
+    // the scene gets its own pool in LoadScene so it can be released without tearing down the renderer
+    const uint32_t staticGeometryMemSize = 32 * 1024 * 1024;
     m_VidMemBufferPool.OnCreate(pDevice, staticGeometryMemSize, true, "StaticGeom");
 
     // initialize the GPU time stamps module
     m_GPUTimer.OnCreate(pDevice, backBufferCount);
 
     // Quick helper to upload resources, it has it's own commandList and uses suballocation.
-    const uint32_t uploadHeapMemSize = 1000 * 1024 * 1024;
-    m_UploadHeap.OnCreate(pDevice, uploadHeapMemSize);    // initialize an upload heap (uses suballocation for faster results)
+    m_UploadHeapSize = MinUploadHeapSize;
+    m_UploadHeap.OnCreate(pDevice, m_UploadHeapSize);    // initialize an upload heap (uses suballocation for faster results)
 
     // Create GBuffer and render passes
     //
@@ -108,6 +118,9 @@ void Renderer::OnCreate(Device* pDevice, SwapChain *pSwapChain, float FontSize)
     // Make sure upload heap has finished uploading before continuing
     m_VidMemBufferPool.UploadData(m_UploadHeap.GetCommandList());
     m_UploadHeap.FlushAndFinish();
+
+    // nothing else will be allocated from this pool
+    m_VidMemBufferPool.FreeUploadHeap();
 }
 
 //--------------------------------------------------------------------------------------
@@ -142,6 +155,9 @@ void Renderer::OnDestroy()
     m_ConstantBufferRing.OnDestroy();
     m_ResourceViewHeaps.OnDestroy();
     m_CommandListRing.OnDestroy();
+
+    m_WorkerPool.OnDestroy();
+    m_FrameArena.OnDestroy();
 }
 
 //--------------------------------------------------------------------------------------
@@ -176,9 +192,38 @@ void Renderer::OnCreateWindowSizeDependentResources(SwapChain *pSwapChain, uint3
 
     // update bloom and downscaling effect
     //
-    m_DownSample.OnCreateWindowSizeDependentResources(m_Width, m_Height, &m_GBuffer.m_HDR, 5); //downsample the HDR texture 5 times
-    m_Bloom.OnCreateWindowSizeDependentResources(m_Width / 2, m_Height / 2, m_DownSample.GetTexture(), 5, &m_GBuffer.m_HDR);
+    m_DownSample.OnCreateWindowSizeDependentResources(m_Width, m_Height, &m_GBuffer.m_HDR, DownsampleMipCount);
+    m_Bloom.OnCreateWindowSizeDependentResources(m_Width / 2, m_Height / 2, m_DownSample.GetTexture(), DownsampleMipCount, &m_GBuffer.m_HDR);
     m_MagnifierPS.OnCreateWindowSizeDependentResources(&m_GBuffer.m_HDR);
+
+    // readback buffers for the occlusion culling, one per frame in flight
+    D3D12_RESOURCE_DESC depthDesc = m_GBuffer.m_DepthBuffer.GetResource()->GetDesc();
+    UINT64 readbackSize;
+    m_pDevice->GetDevice()->GetCopyableFootprints(&depthDesc, 0, 1, 0, &m_DepthReadbackFootprint, NULL, NULL, &readbackSize);
+    for (int i = 0; i < backBufferCount; i++)
+    {
+        ThrowIfFailed(m_pDevice->GetDevice()->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK), D3D12_HEAP_FLAG_NONE, &CD3DX12_RESOURCE_DESC::Buffer(readbackSize), D3D12_RESOURCE_STATE_COPY_DEST, NULL, IID_PPV_ARGS(&m_pDepthReadback[i])));
+        m_pDepthReadback[i]->SetName(L"DepthReadback");
+        m_bDepthReadbackPending[i] = false;
+    }
+    m_DepthPyramid.Invalidate();
+
+    PlanTransientTargets(Width, Height);
+}
+
+//--------------------------------------------------------------------------------------
+//
+// PlanTransientTargets, works out how much memory the window size dependent targets would need if the
+// ones with lifetimes that don't overlap shared their memory
+//
+//--------------------------------------------------------------------------------------
+void Renderer::PlanTransientTargets(uint32_t Width, uint32_t Height)
+{
+    const TransientResourcePlanner &planner = m_TransientPlanner;
+    PlanWindowSizeDependentTargets(&m_TransientPlanner, Width, Height, DownsampleMipCount);
+
+    Trace(format("Window size dependent targets at %ux%u: %llu MB, %llu MB with the transient ones sharing %u heaps\n",
+        Width, Height, (unsigned long long)(planner.GetDedicatedSize() >> 20), (unsigned long long)(planner.GetAliasedSize() >> 20), planner.GetHeapCount()));
 }
 
 //--------------------------------------------------------------------------------------
@@ -201,6 +246,14 @@ void Renderer::OnDestroyWindowSizeDependentResources()
     m_ShadowMask.OnDestroy();
 #endif
 
+    for (int i = 0; i < backBufferCount; i++)
+    {
+        if (m_pDepthReadback[i])
+        {
+            m_pDepthReadback[i]->Release();
+            m_pDepthReadback[i] = NULL;
+        }
+    }
 }
 
 void Renderer::OnUpdateDisplayDependentResources(SwapChain* pSwapChain)
@@ -218,12 +271,22 @@ void Renderer::OnUpdateDisplayDependentResources(SwapChain* pSwapChain)
 //--------------------------------------------------------------------------------------
 int Renderer::LoadScene(GLTFCommon *pGLTFCommon, int Stage)
 {
+    // The loading is split in stages that depend on each other, one stage per frame so we can show a progress bar:
+    //
+    //   1 - buffers:  parse the glTF buffers, the geometry gets copied into the sysmem side of the static pool
+    //   2 - textures: decode the images as jobs on the async pool, they stream through the upload heap
+    //   3 - passes:   create the depth, PBR and bbox passes back to back (they need the texture views from 2), their
+    //                 shaders and PSOs are compiled as jobs on the async pool so the three passes overlap each other
+    //   4 - flush:    record the geometry copy once, wait for the async jobs and do the only CPU/GPU sync of the load
+    //
+    const int stageCount = 4;
+
     // show loading progress
     //
     ImGui::OpenPopup("Loading");
     if (ImGui::BeginPopupModal("Loading", NULL, ImGuiWindowFlags_AlwaysAutoResize))
     {
-        float progress = (float)Stage / 13.0f;
+        float progress = (float)Stage / (float)stageCount;
         ImGui::ProgressBar(progress, ImVec2(0.f, 0.f), NULL);
         ImGui::EndPopup();
     }
@@ -235,25 +298,53 @@ int Renderer::LoadScene(GLTFCommon *pGLTFCommon, int Stage)
     //
     if (Stage == 0)
     {
+        // the mip chain of a texture slice is uploaded in one go, resize the heap to fit this scene's largest
+        const uint64_t largestTextureSize = GetLargestTextureUploadSize(pGLTFCommon);
+        const uint64_t uploadHeapMemSize = (std::max<uint64_t>(largestTextureSize, MinUploadHeapSize) + 0xFFFFF) & ~0xFFFFFull;
+        if (uploadHeapMemSize != m_UploadHeapSize)
+        {
+            m_UploadHeap.OnDestroy();
+            m_UploadHeapSize = (uint32_t)uploadHeapMemSize;
+            m_UploadHeap.OnCreate(m_pDevice, m_UploadHeapSize);
+        }
+        Trace(format("Upload heap: %u MB\n", m_UploadHeapSize / (1024 * 1024)));
+
+        m_SceneTextureSize = GetSceneTextureSize(pGLTFCommon);
     }
-    else if (Stage == 5)
+    else if (Stage == 1)
     {
         Profile p("m_pGltfLoader->Load");
+        TraceScope traceScope("LoadScene: m_pGltfLoader->Load");
+
+        // Create a 'static' pool for the vertices and indices of the scene, sized after what its accessors take or after
+        // what the scene used on a previous run if that was more
+        m_ScenePoolSize = m_ScenePoolHistory.GetPoolSize(pGLTFCommon, GetSceneGeometryPoolSize(pGLTFCommon));
+        m_SceneBufferPool.OnCreate(m_pDevice, m_ScenePoolSize, true, "SceneGeom");
+        // the first allocation gives the base address of the pool, GetScenePoolUsage measures from there
+        void *pBaseData;
+        D3D12_VERTEX_BUFFER_VIEW baseView;
+        m_SceneBufferPool.AllocBuffer(1, 1, &pBaseData, &baseView);
+        m_ScenePoolBase = baseView.BufferLocation;
 
         m_pGLTFTexturesAndBuffers = new GLTFTexturesAndBuffers();
-        m_pGLTFTexturesAndBuffers->OnCreate(m_pDevice, pGLTFCommon, &m_UploadHeap, &m_VidMemBufferPool, &m_ConstantBufferRing);
+        m_pGLTFTexturesAndBuffers->OnCreate(m_pDevice, pGLTFCommon, &m_UploadHeap, &m_SceneBufferPool, &m_ConstantBufferRing);
+
+        // per node bounds for the frustum culling
+        m_SceneCuller.OnCreate(pGLTFCommon);
     }
-    else if (Stage == 6)
+    else if (Stage == 2)
     {
         Profile p("LoadTextures");
+        TraceScope traceScope("LoadScene: LoadTextures");
 
         // here we are loading onto the GPU all the textures and the inverse matrices
         // this data will be used to create the PBR and Depth passes       
         m_pGLTFTexturesAndBuffers->LoadTextures(pAsyncPool);
     }
-    else if (Stage == 7)
+    else if (Stage == 3)
     {
-        Profile p("m_GLTFDepth->OnCreate");
+        Profile p("Create passes");
+        TraceScope traceScope("LoadScene: Create passes");
 
         //create the glTF's textures, VBs, IBs, shaders and descriptors for this particular pass
         m_GLTFDepth = new GltfDepthPass();
@@ -262,14 +353,10 @@ int Renderer::LoadScene(GLTFCommon *pGLTFCommon, int Stage)
             &m_UploadHeap,
             &m_ResourceViewHeaps,
             &m_ConstantBufferRing,
-            &m_VidMemBufferPool,
+            &m_SceneBufferPool,
             m_pGLTFTexturesAndBuffers,
             pAsyncPool
         );
-    }
-    else if (Stage == 9)
-    {
-        Profile p("m_GLTFPBR->OnCreate");
 
         // same thing as above but for the PBR pass
         m_GLTFPBR = new GltfPbrPass();
@@ -286,11 +373,6 @@ int Renderer::LoadScene(GLTFCommon *pGLTFCommon, int Stage)
             pAsyncPool
         );
 
-    }
-    else if (Stage == 10)
-    {
-        Profile p("m_GLTFBBox->OnCreate");
-
         // just a bounding box pass that will draw boundingboxes instead of the geometry itself
         m_GLTFBBox = new GltfBBoxPass();
         m_GLTFBBox->OnCreate(
@@ -298,23 +380,28 @@ int Renderer::LoadScene(GLTFCommon *pGLTFCommon, int Stage)
             &m_UploadHeap,
             &m_ResourceViewHeaps,
             &m_ConstantBufferRing,
-            &m_VidMemBufferPool,
+            &m_SceneBufferPool,
             m_pGLTFTexturesAndBuffers,
             &m_Wireframe
         );
-
-        // we are borrowing the upload heap command list for uploading to the GPU the IBs and VBs
-        m_VidMemBufferPool.UploadData(m_UploadHeap.GetCommandList());
-
     }
-    else if (Stage == 11)
+    else if (Stage == 4)
     {
         Profile p("Flush");
+        TraceScope traceScope("LoadScene: Flush");
 
+        // wait for the PSOs still being compiled by the async pool
+        m_AsyncPool.Flush();
+
+        // all the geometry is in, the pool can't grow so what it used is kept for sizing it on the next run
+        m_ScenePoolHistory.Record(pGLTFCommon, GetScenePoolUsage(), m_ScenePoolSize);
+
+        // we are borrowing the upload heap command list for uploading to the GPU the IBs and VBs of all the passes at once
+        m_SceneBufferPool.UploadData(m_UploadHeap.GetCommandList());
         m_UploadHeap.FlushAndFinish();
 
         //once everything is uploaded we dont need he upload heaps anymore
-        m_VidMemBufferPool.FreeUploadHeap();
+        m_SceneBufferPool.FreeUploadHeap();
 
         // tell caller that we are done loading the map
         return 0;
@@ -324,6 +411,21 @@ int Renderer::LoadScene(GLTFCommon *pGLTFCommon, int Stage)
     return Stage;
 }
 
+//--------------------------------------------------------------------------------------
+//
+// GetScenePoolUsage, Cauldron doesn't tell how much of a StaticBufferPool is used, but a tiny allocation lands right
+// after the last one. Returns UINT32_MAX if the pool is full
+//
+//--------------------------------------------------------------------------------------
+uint32_t Renderer::GetScenePoolUsage()
+{
+    void *pData;
+    D3D12_VERTEX_BUFFER_VIEW probe;
+    if (!m_SceneBufferPool.AllocBuffer(1, 1, &pData, &probe))
+        return UINT32_MAX;
+    return (uint32_t)(probe.BufferLocation - m_ScenePoolBase);
+}
+
 //--------------------------------------------------------------------------------------
 //
 // UnloadScene
@@ -362,8 +464,19 @@ void Renderer::UnloadScene()
         m_pGLTFTexturesAndBuffers->OnDestroy();
         delete m_pGLTFTexturesAndBuffers;
         m_pGLTFTexturesAndBuffers = NULL;
+
+        // the pool was created along with the textures and buffers, all the scene geometry goes away with it
+        m_SceneBufferPool.OnDestroy();
+        m_ScenePoolSize = 0;
+
+        m_SceneCuller.OnDestroy();
     }
 
+    // the state ids are keyed by the primitives and materials of the scene
+    m_BatchSorter.Reset();
+    m_LightSelector.Reset();
+    m_DepthPyramid.Invalidate();
+
     while (!m_shadowMapPool.empty())
     {
         m_shadowMapPool.back().ShadowMap.OnDestroy();
@@ -373,27 +486,27 @@ void Renderer::UnloadScene()
 
 void Renderer::AllocateShadowMaps(GLTFCommon* pGLTFCommon)
 {
+    // The per frame constants only hold MaxShadowInstances shadows, the lights past that are lit without one
+    const uint32_t droppedShadows = m_LightSelector.LimitShadowedLights(pGLTFCommon, MaxShadowInstances);
+    if (droppedShadows)
+        Trace(format("%u lights exceed the %d shadow maps supported, they won't cast shadows\n", droppedShadows, (int)MaxShadowInstances));
+
     // Go through the lights and allocate shadow information
     uint32_t NumShadows = 0;
     for (int i = 0; i < pGLTFCommon->m_lightInstances.size(); ++i)
     {
         const tfLight& lightData = pGLTFCommon->m_lights[pGLTFCommon->m_lightInstances[i].m_lightId];
-        if (lightData.m_shadowResolution)
+        if (m_LightSelector.HasShadow(pGLTFCommon, i))
         {
             SceneShadowInfo ShadowInfo;
             ShadowInfo.ShadowResolution = lightData.m_shadowResolution;
             ShadowInfo.ShadowIndex = NumShadows++;
             ShadowInfo.LightIndex = i;
+            ShadowInfo.bCached = false;
             m_shadowMapPool.push_back(ShadowInfo);
         }
     }
 
-    if (NumShadows > MaxShadowInstances)
-    {
-        Trace("Number of shadows has exceeded maximum supported. Please grow value in gltfCommon.h/perFrameStruct.h");
-        throw;
-    }
-
     // If we had shadow information, allocate all required maps and bindings
     if (!m_shadowMapPool.empty())
     {
@@ -410,6 +523,190 @@ void Renderer::AllocateShadowMaps(GLTFCommon* pGLTFCommon)
     }
 }
 
+//--------------------------------------------------------------------------------------
+//
+// UpdateDepthPyramid, the depth read back backBufferCount frames ago is done by now
+//
+//--------------------------------------------------------------------------------------
+void Renderer::UpdateDepthPyramid(bool bEnabled)
+{
+    if (!bEnabled)
+    {
+        m_DepthPyramid.Invalidate();
+        for (int i = 0; i < backBufferCount; i++)
+            m_bDepthReadbackPending[i] = false;
+        return;
+    }
+
+    const uint32_t slot = m_DepthReadbackIndex;
+    if (!m_bDepthReadbackPending[slot])
+        return;
+
+    TraceScope traceScope("Build depth pyramid");
+
+    const D3D12_SUBRESOURCE_FOOTPRINT &footprint = m_DepthReadbackFootprint.Footprint;
+    D3D12_RANGE readRange = { 0, (SIZE_T)(m_DepthReadbackFootprint.Offset + (UINT64)footprint.RowPitch * footprint.Height) };
+    void *pData = NULL;
+    if (SUCCEEDED(m_pDepthReadback[slot]->Map(0, &readRange, &pData)))
+    {
+        const float *pDepth = (const float *)((const uint8_t *)pData + m_DepthReadbackFootprint.Offset);
+        m_DepthPyramid.Build(pDepth, footprint.Width, footprint.Height, footprint.RowPitch, m_DepthReadbackViewProj[slot], &m_WorkerPool);
+
+        D3D12_RANGE writeRange = { 0, 0 };
+        m_pDepthReadback[slot]->Unmap(0, &writeRange);
+    }
+    m_bDepthReadbackPending[slot] = false;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// SortOpaqueBatchList
+//
+//--------------------------------------------------------------------------------------
+void Renderer::SortOpaqueBatchList(std::vector<GltfPbrPass::BatchList> *pBatchList, bool bSort)
+{
+    TraceScope traceScope("SortOpaqueBatchList");
+
+    m_OpaqueBatchCount = (uint32_t)pBatchList->size();
+
+    // as long as the same primitives come out of BuildBatchLists the last order holds, skip the keys and the sort
+    m_BatchPrimitives.resize(pBatchList->size());
+    for (size_t i = 0; i < pBatchList->size(); i++)
+        m_BatchPrimitives[i] = (*pBatchList)[i].m_pPrimitive;
+
+    m_bBatchOrderCached = bSort && m_BatchSorter.IsOrderCached(m_BatchPrimitives);
+    if (m_bBatchOrderCached)
+    {
+        m_SortedBatches.clear();
+        for (uint32_t index : m_BatchSorter.GetOrder())
+            m_SortedBatches.push_back((*pBatchList)[index]);
+        pBatchList->swap(m_SortedBatches);
+        return;
+    }
+
+    m_BatchSortKeys.resize(pBatchList->size());
+    for (size_t i = 0; i < pBatchList->size(); i++)
+    {
+        const GltfPbrPass::BatchList &batch = (*pBatchList)[i];
+        const uint32_t materialId = m_BatchSorter.GetMaterialId(batch.m_pPrimitive->m_pMaterial);
+        const uint32_t primitiveId = m_BatchSorter.GetPrimitiveId(batch.m_pPrimitive);
+        m_BatchSortKeys[i] = BatchSorter::MakeKey(materialId, primitiveId, batch.m_depth);
+    }
+
+    if (!bSort)
+    {
+        m_RepeatedStateCount = BatchSorter::CountRepeatedStates(m_BatchSortKeys.data(), (uint32_t)m_BatchSortKeys.size());
+        return;
+    }
+
+    const std::vector<uint32_t> &order = m_BatchSorter.Sort(m_BatchSortKeys);
+    m_RepeatedStateCount = m_BatchSorter.GetRepeatedStateCount();
+
+    m_SortedBatches.clear();
+    for (uint32_t index : order)
+        m_SortedBatches.push_back((*pBatchList)[index]);
+    pBatchList->swap(m_SortedBatches);
+}
+
+//--------------------------------------------------------------------------------------
+//
+// DrawDepthPrepass, clears the GBuffer and lays down the depth of the opaque geometry so the
+// PBR pass only shades the pixels that end up visible
+//
+// Cauldron's GltfPbrPass doesn't let us set an EQUAL test with depth writes off, it keeps
+// LESS_EQUAL with writes on. That only rejects the hidden pixels if GltfDepthPass and
+// GltfPbrPass produce bit-identical depth, both transform the positions with the same
+// per-frame matrix and the same skinning code, keep it that way when touching either shader.
+// The prepass has not been measured to pay off on Sponza, so it is off in its config
+//
+//--------------------------------------------------------------------------------------
+void Renderer::DrawDepthPrepass(ID3D12GraphicsCommandList *pCmdLst, const per_frame *pPerFrame, const NodeMask *pVisible)
+{
+    // let the GBuffer pass clear its targets, then bind just the depth
+    m_RenderPassFullGBuffer.BeginPass(pCmdLst, true);
+    pCmdLst->OMSetRenderTargets(0, NULL, false, &m_GBuffer.m_DepthBufferDSV.GetCPU());
+
+    per_frame *cbDepthPerFrame = m_GLTFDepth->SetPerFrameConstants();
+    cbDepthPerFrame->mCameraCurrViewProj = pPerFrame->mCameraCurrViewProj;
+    cbDepthPerFrame->lodBias = pPerFrame->lodBias;
+
+    // the nodes with blended primitives would hide what's behind them, they are left to the PBR passes
+    m_SceneCuller.GetDepthPrepassNodes(pVisible, &m_PrepassVisibility);
+    {
+        ScopedNodeVisibility visibility(m_pGLTFTexturesAndBuffers->m_pGLTFCommon, &m_PrepassVisibility, &m_FrameArena);
+        m_GLTFDepth->Draw(pCmdLst);
+    }
+
+    m_GPUTimer.GetTimeStamp(pCmdLst, "Depth prepass");
+    m_RenderPassFullGBuffer.EndPass();
+}
+
+//--------------------------------------------------------------------------------------
+//
+// DrawOpaqueBatchList, returns the command list to keep recording into
+//
+//--------------------------------------------------------------------------------------
+ID3D12GraphicsCommandList *Renderer::DrawOpaqueBatchList(ID3D12GraphicsCommandList *pCmdLst, CBV_SRV_UAV *pShadowSRV, std::vector<GltfPbrPass::BatchList> *pBatchList, bool bWireframe, bool bClear)
+{
+    // below this many batches per chunk the recording is cheaper than waking up the workers
+    const uint32_t minBatchesPerChunk = 256;
+
+    const uint32_t maxChunks = std::min((uint32_t)MaxRecordingChunks, m_WorkerPool.GetThreadCount());
+    const uint32_t batchCount = (uint32_t)pBatchList->size();
+    const uint32_t chunkCount = std::min(maxChunks, (batchCount + minBatchesPerChunk - 1) / minBatchesPerChunk);
+
+    m_RenderPassFullGBuffer.BeginPass(pCmdLst, bClear);
+
+    if (chunkCount <= 1)
+    {
+        m_GLTFPBR->DrawBatchList(pCmdLst, pShadowSRV, pBatchList, bWireframe);
+        m_GPUTimer.GetTimeStamp(pCmdLst, "PBR Opaque");
+        m_RenderPassFullGBuffer.EndPass();
+        return pCmdLst;
+    }
+
+    // the lists have to be taken from the ring on this thread, the ring is not thread safe
+    ID3D12GraphicsCommandList *pChunkCmdLsts[MaxRecordingChunks];
+    for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+    {
+        const uint32_t first = (batchCount * chunk) / chunkCount;
+        const uint32_t last = (batchCount * (chunk + 1)) / chunkCount;
+        m_OpaqueChunks[chunk].assign(pBatchList->begin() + first, pBatchList->begin() + last);
+        pChunkCmdLsts[chunk] = m_CommandListRing.GetNewCommandList();
+    }
+
+    m_WorkerPool.ParallelFor(chunkCount, [&](uint32_t chunk)
+    {
+        TraceScope traceScope("Record opaque chunk");
+
+        // command lists don't inherit any state, set the targets again without clearing them
+        ID3D12GraphicsCommandList *pChunkCmdLst = pChunkCmdLsts[chunk];
+        pChunkCmdLst->RSSetViewports(1, &m_Viewport);
+        pChunkCmdLst->RSSetScissorRects(1, &m_RectScissor);
+        m_RenderPassFullGBuffer.BeginPass(pChunkCmdLst, false);
+
+        m_GLTFPBR->DrawBatchList(pChunkCmdLst, pShadowSRV, &m_OpaqueChunks[chunk], bWireframe);
+
+        m_RenderPassFullGBuffer.EndPass();
+        ThrowIfFailed(pChunkCmdLst->Close());
+    });
+
+    // submit everything recorded so far followed by the chunks, in order
+    ThrowIfFailed(pCmdLst->Close());
+    ID3D12CommandList *pCmdLsts[MaxRecordingChunks + 1] = { pCmdLst };
+    for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+        pCmdLsts[chunk + 1] = pChunkCmdLsts[chunk];
+    m_pDevice->GetGraphicsQueue()->ExecuteCommandLists(chunkCount + 1, pCmdLsts);
+
+    // carry on with a fresh list
+    pCmdLst = m_CommandListRing.GetNewCommandList();
+    pCmdLst->RSSetViewports(1, &m_Viewport);
+    pCmdLst->RSSetScissorRects(1, &m_RectScissor);
+    m_GPUTimer.GetTimeStamp(pCmdLst, "PBR Opaque");
+
+    return pCmdLst;
+}
+
 //--------------------------------------------------------------------------------------
 //
 // OnRender
@@ -417,6 +714,12 @@ void Renderer::AllocateShadowMaps(GLTFCommon* pGLTFCommon)
 //--------------------------------------------------------------------------------------
 void Renderer::OnRender(const UIState* pState, const Camera& Cam, SwapChain* pSwapChain)
 {
+    // the heap allocations this thread makes during the frame, only counted in debug builds
+    const uint64_t heapAllocationStart = HeapAllocationCounter::GetThreadCount();
+
+    TraceRecorder::Get().OnBeginFrame();
+    TraceScope traceScope("Renderer::OnRender");
+
     // Timing values
     UINT64 gpuTicksPerSecond;
     m_pDevice->GetGraphicsQueue()->GetTimestampFrequency(&gpuTicksPerSecond);
@@ -424,14 +727,24 @@ void Renderer::OnRender(const UIState* pState, const Camera& Cam, SwapChain* pSw
     // Let our resource managers do some house keeping
     m_CommandListRing.OnBeginFrame();
     m_ConstantBufferRing.OnBeginFrame();
+    m_FrameArena.OnBeginFrame();
     m_GPUTimer.OnBeginFrame(gpuTicksPerSecond, &m_TimeStamps);
+    TraceRecorder::Get().AddGpuTimestamps(m_TimeStamps, backBufferCount);
+
+    UpdateDepthPyramid(pState->bOcclusionCulling);
 
     // Sets the perFrame data 
     per_frame *pPerFrame = NULL;
     if (m_pGLTFTexturesAndBuffers)
     {
+        // only the lights that reach the view fit in the per frame constants
+        m_LightSelector.Select(m_pGLTFTexturesAndBuffers->m_pGLTFCommon, Cam.GetProjection() * Cam.GetView(), Cam.GetPosition(), MaxLightInstances);
+
         // fill as much as possible using the GLTF (camera, lights, ...)
-        pPerFrame = m_pGLTFTexturesAndBuffers->m_pGLTFCommon->SetPerFrameData(Cam);
+        {
+            ScopedLightSelection lightSelection(m_pGLTFTexturesAndBuffers->m_pGLTFCommon, &m_LightSelector);
+            pPerFrame = m_pGLTFTexturesAndBuffers->m_pGLTFCommon->SetPerFrameData(Cam);
+        }
 
         // Set some lighting factors
         pPerFrame->iblFactor = pState->IBLFactor;
@@ -443,9 +756,12 @@ void Renderer::OnRender(const UIState* pState, const Camera& Cam, SwapChain* pSw
         pPerFrame->wireframeOptions.setY(pState->WireframeColor[1]);
         pPerFrame->wireframeOptions.setZ(pState->WireframeColor[2]);
         pPerFrame->wireframeOptions.setW(pState->WireframeMode == UIState::WireframeMode::WIREFRAME_MODE_SOLID_COLOR ? 1.0f : 0.0f);
-        pPerFrame->lodBias = 0.0f;
+        pPerFrame->lodBias = pState->TextureLodBias;
         m_pGLTFTexturesAndBuffers->SetPerFrameConstants();
         m_pGLTFTexturesAndBuffers->SetSkinningMatricesForSkeletons();
+
+        // the world matrices are final at this point, refresh the bounds used for culling
+        m_SceneCuller.UpdateBounds();
     }
 
     // command buffer calls
@@ -455,42 +771,86 @@ void Renderer::OnRender(const UIState* pState, const Camera& Cam, SwapChain* pSw
 
     pCmdLst1->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(pSwapChain->GetCurrentBackBufferResource(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
 
-    // Render shadow maps 
-    std::vector<CD3DX12_RESOURCE_BARRIER> ShadowReadBarriers;
-    std::vector<CD3DX12_RESOURCE_BARRIER> ShadowWriteBarriers;
+    // Render shadow maps, the cached ones are left untouched in the shader resource state
     if (m_GLTFDepth && pPerFrame != NULL)
     {
-        std::vector<SceneShadowInfo>::iterator ShadowMap = m_shadowMapPool.begin();
-        while (ShadowMap < m_shadowMapPool.end())
+        TraceScope traceShadows("Record shadow maps");
+
+        // pick the maps that need to be rendered, a cached map stays valid until its light moves or something moves in front of it
+        FrameVector<SceneShadowInfo*> ShadowMapsToRender(&m_FrameArena);
+        FrameVector<CD3DX12_RESOURCE_BARRIER> ShadowWriteBarriers(&m_FrameArena);
+        FrameVector<CD3DX12_RESOURCE_BARRIER> ShadowReadBarriers(&m_FrameArena);
+        ShadowMapsToRender.reserve(m_shadowMapPool.size());
+        ShadowWriteBarriers.reserve(m_shadowMapPool.size());
+        ShadowReadBarriers.reserve(m_shadowMapPool.size());
+        for (SceneShadowInfo &ShadowMap : m_shadowMapPool)
+        {
+            const math::Matrix4 &lightViewProj = pPerFrame->lights[m_LightSelector.GetSlot(ShadowMap.LightIndex)].mLightViewProj;
+            const bool bLightMoved = !ShadowMap.bCached || memcmp(&ShadowMap.CachedViewProj, &lightViewProj, sizeof(math::Matrix4)) != 0;
+            if (pState->bCacheShadowMaps && !bLightMoved && !m_SceneCuller.HasMovedNodesInside(lightViewProj))
+                continue;
+
+            // new maps start in the depth write state
+            if (ShadowMap.bCached)
+                ShadowWriteBarriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(ShadowMap.ShadowMap.GetResource(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_DEPTH_WRITE));
+            ShadowReadBarriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(ShadowMap.ShadowMap.GetResource(), D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+
+            ShadowMap.bCached = true;
+            ShadowMap.CachedViewProj = lightViewProj;
+            ShadowMapsToRender.push_back(&ShadowMap);
+        }
+        m_RenderedShadowMapCount = (uint32_t)ShadowMapsToRender.size();
+        m_ShadowDrawCount = 0;
+
+        if (!ShadowWriteBarriers.empty())
+            pCmdLst1->ResourceBarrier((UINT)ShadowWriteBarriers.size(), ShadowWriteBarriers.data());
+
+        for (SceneShadowInfo *ShadowMap : ShadowMapsToRender)
         {
             pCmdLst1->ClearDepthStencilView(m_ShadowMapPoolDSV.GetCPU(ShadowMap->ShadowIndex), D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
-            ++ShadowMap;
         }
         m_GPUTimer.GetTimeStamp(pCmdLst1, "Clear shadow maps");
 
-        // Render all shadows
-        ShadowMap = m_shadowMapPool.begin();
-        while (ShadowMap < m_shadowMapPool.end())
+        // Render the shadows
+        for (SceneShadowInfo *ShadowMap : ShadowMapsToRender)
         {
             SetViewportAndScissor(pCmdLst1, 0, 0, ShadowMap->ShadowResolution, ShadowMap->ShadowResolution);
             pCmdLst1->OMSetRenderTargets(0, NULL, false, &m_ShadowMapPoolDSV.GetCPU(ShadowMap->ShadowIndex));
             
             per_frame* cbDepthPerFrame = m_GLTFDepth->SetPerFrameConstants();
-            cbDepthPerFrame->mCameraCurrViewProj = pPerFrame->lights[ShadowMap->LightIndex].mLightViewProj;
+            cbDepthPerFrame->mCameraCurrViewProj = ShadowMap->CachedViewProj;
             cbDepthPerFrame->lodBias = 0.0f;
 
-            m_GLTFDepth->Draw(pCmdLst1);
+            {
+                const NodeMask *pVisible = NULL;
+                uint32_t drawCount = m_SceneCuller.GetPrimitiveCount();
+                if (pState->bFrustumCulling)
+                {
+                    m_SceneCuller.Cull(cbDepthPerFrame->mCameraCurrViewProj, &m_ShadowVisibility, &drawCount);
+                    pVisible = &m_ShadowVisibility;
+                }
+                m_ShadowDrawCount += drawCount;
 
-            // Push a barrier
-            ShadowReadBarriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(ShadowMap->ShadowMap.GetResource(), D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
-            ShadowWriteBarriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(ShadowMap->ShadowMap.GetResource(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_DEPTH_WRITE));
+                ScopedNodeVisibility visibility(m_pGLTFTexturesAndBuffers->m_pGLTFCommon, pVisible, &m_FrameArena);
+                m_GLTFDepth->Draw(pCmdLst1);
+            }
 
             m_GPUTimer.GetTimeStamp(pCmdLst1, "Shadow map");
-            ++ShadowMap;
         }
         
         // Transition all shadow map barriers
-        pCmdLst1->ResourceBarrier((UINT)ShadowReadBarriers.size(), ShadowReadBarriers.data());
+        if (!ShadowReadBarriers.empty())
+            pCmdLst1->ResourceBarrier((UINT)ShadowReadBarriers.size(), ShadowReadBarriers.data());
+
+        // hand the shadow maps over to the GPU, it renders them while the rest of the frame gets recorded
+        if (!ShadowMapsToRender.empty())
+        {
+            ThrowIfFailed(pCmdLst1->Close());
+            ID3D12CommandList *pShadowCmdLsts[] = { pCmdLst1 };
+            m_pDevice->GetGraphicsQueue()->ExecuteCommandLists(1, pShadowCmdLsts);
+
+            pCmdLst1 = m_CommandListRing.GetNewCommandList();
+        }
     }
 
     // Shadow resolve ---------------------------------------------------------------------------
@@ -533,20 +893,63 @@ void Renderer::OnRender(const UIState* pState, const Camera& Cam, SwapChain* pSw
         {
             const bool bWireframe = pState->WireframeMode != UIState::WireframeMode::WIREFRAME_MODE_OFF;
 
-            std::vector<GltfPbrPass::BatchList> opaque, transparent;
-            m_GLTFPBR->BuildBatchLists(&opaque, &transparent, bWireframe);
+            // the lists are kept across frames so their storage gets reused
+            std::vector<GltfPbrPass::BatchList> &opaque = m_OpaqueBatches, &transparent = m_TransparentBatches;
+            opaque.clear();
+            transparent.clear();
 
-            // Render opaque geometry
+            // nodes outside of the camera frustum never make it into the batch lists
+            const NodeMask *pVisible = NULL;
             {
-                m_RenderPassFullGBuffer.BeginPass(pCmdLst1, true);
+                if (pState->bFrustumCulling)
+                {
+                    m_VisibleNodeCount = m_SceneCuller.Cull(pPerFrame->mCameraCurrViewProj, &m_CameraVisibility);
+                    m_OccludedNodeCount = pState->bOcclusionCulling ? m_SceneCuller.CullOccluded(m_DepthPyramid, &m_CameraVisibility) : 0;
+                    m_VisibleNodeCount -= m_OccludedNodeCount;
+                    pVisible = &m_CameraVisibility;
+                }
+                else
+                {
+                    m_VisibleNodeCount = m_SceneCuller.GetCullableCount();
+                    m_OccludedNodeCount = 0;
+                }
+
+                ScopedNodeVisibility visibility(m_pGLTFTexturesAndBuffers->m_pGLTFCommon, pVisible, &m_FrameArena);
+                TraceScope traceBatchLists("BuildBatchLists");
+                m_GLTFPBR->BuildBatchLists(&opaque, &transparent, bWireframe);
+            }
+
+            SortOpaqueBatchList(&opaque, pState->bSortOpaqueBatches);
+
+            // with the depth laid down first, the PBR pass' depth test rejects all the overdrawn pixels before shading them
+            const bool bDepthPrepass = pState->bDepthPrepass && !bWireframe;
+            if (bDepthPrepass)
+                DrawDepthPrepass(pCmdLst1, pPerFrame, pVisible);
+
+            // Render opaque geometry
 #if USE_SHADOWMASK
-                m_GLTFPBR->DrawBatchList(pCmdLst1, &m_ShadowMaskSRV, &solid, bWireframe);
+            pCmdLst1 = DrawOpaqueBatchList(pCmdLst1, &m_ShadowMaskSRV, &opaque, bWireframe, !bDepthPrepass);
 #else
-                m_GLTFPBR->DrawBatchList(pCmdLst1, &m_ShadowMapPoolSRV, &opaque, bWireframe);
+            pCmdLst1 = DrawOpaqueBatchList(pCmdLst1, &m_ShadowMapPoolSRV, &opaque, bWireframe, !bDepthPrepass);
 #endif
-                m_GPUTimer.GetTimeStamp(pCmdLst1, "PBR Opaque");
-                m_RenderPassFullGBuffer.EndPass();
+
+            // read the depth of the opaque geometry back, it becomes the occluders of a later frame
+            if (pState->bOcclusionCulling)
+            {
+                ID3D12Resource *pDepth = m_GBuffer.m_DepthBuffer.GetResource();
+                pCmdLst1->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(pDepth, D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_COPY_SOURCE));
+
+                CD3DX12_TEXTURE_COPY_LOCATION dst(m_pDepthReadback[m_DepthReadbackIndex], m_DepthReadbackFootprint);
+                CD3DX12_TEXTURE_COPY_LOCATION src(pDepth, 0);
+                pCmdLst1->CopyTextureRegion(&dst, 0, 0, 0, &src, NULL);
+
+                pCmdLst1->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(pDepth, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_DEPTH_WRITE));
+                m_GPUTimer.GetTimeStamp(pCmdLst1, "Depth readback");
+
+                m_DepthReadbackViewProj[m_DepthReadbackIndex] = pPerFrame->mCameraCurrViewProj;
+                m_bDepthReadbackPending[m_DepthReadbackIndex] = true;
             }
+            m_DepthReadbackIndex = (m_DepthReadbackIndex + 1) % backBufferCount;
 
             // draw skydome
             {
@@ -619,9 +1022,6 @@ void Renderer::OnRender(const UIState* pState, const Camera& Cam, SwapChain* pSw
         }
     }
 
-    if (ShadowWriteBarriers.size())
-        pCmdLst1->ResourceBarrier((UINT)ShadowWriteBarriers.size(), ShadowWriteBarriers.data());
-
     D3D12_RESOURCE_BARRIER preResolve[1] = {
         CD3DX12_RESOURCE_BARRIER::Transition(m_GBuffer.m_HDR.GetResource(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE),
     };
@@ -773,4 +1173,8 @@ void Renderer::OnRender(const UIState* pState, const Camera& Cam, SwapChain* pSw
         m_SaveTexture.SaveStagingTextureAsJpeg(m_pDevice->GetDevice(), m_pDevice->GetGraphicsQueue(), m_pScreenShotName.c_str());
         m_pScreenShotName.clear();
     }
+
+    // only steady state frames are reported, the frames where the arena had to grow are still warming up
+    if (m_FrameArena.GetHeapAllocationCount() == 0)
+        m_FrameHeapAllocationCount = (uint32_t)(HeapAllocationCounter::GetThreadCount() - heapAllocationStart);
 }
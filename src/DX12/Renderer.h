@@ -22,6 +22,15 @@
 
 #include "base/GBuffer.h"
 #include "PostProc/MagnifierPS.h"
+#include "SceneCulling.h"
+#include "LightSelection.h"
+#include "BatchSorting.h"
+#include "FrameArena.h"
+#include "HeapAllocationCounter.h"
+#include "WorkerPool.h"
+#include "TraceRecorder.h"
+#include "TransientResources.h"
+#include "ScenePools.h"
 
 struct UIState;
 
@@ -50,12 +59,38 @@ public:
 
     void AllocateShadowMaps(GLTFCommon* pGLTFCommon);
 
+    WorkerPool *GetWorkerPool() { return &m_WorkerPool; }
+
+    uint32_t GetCullableNodeCount() const { return m_SceneCuller.GetCullableCount(); }
+    uint32_t GetVisibleNodeCount() const { return m_VisibleNodeCount; }
+    uint32_t GetOccludedNodeCount() const { return m_OccludedNodeCount; }
+    uint32_t GetShadowMapCount() const { return (uint32_t)m_shadowMapPool.size(); }
+    uint32_t GetRenderedShadowMapCount() const { return m_RenderedShadowMapCount; }
+    uint32_t GetShadowDrawCount() const { return m_ShadowDrawCount; }
+    uint32_t GetLightCount() const { return m_LightSelector.GetLightCount(); }
+    uint32_t GetSelectedLightCount() const { return m_LightSelector.GetSelectedCount(); }
+    uint32_t GetOpaqueBatchCount() const { return m_OpaqueBatchCount; }
+    uint32_t GetRepeatedStateCount() const { return m_RepeatedStateCount; }
+    bool IsBatchOrderCached() const { return m_bBatchOrderCached; }
+    const FrameArena &GetFrameArena() const { return m_FrameArena; }
+    uint32_t GetFrameHeapAllocationCount() const { return m_FrameHeapAllocationCount; }
+    const TransientResourcePlanner &GetTransientPlanner() const { return m_TransientPlanner; }
+    uint32_t GetScenePoolSize() const { return m_ScenePoolSize; }
+    uint64_t GetSceneTextureSize() const { return m_SceneTextureSize; }
+
     const std::vector<TimeStamp>& GetTimingValues() const { return m_TimeStamps; }
     std::string& GetScreenshotFileName() { return m_pScreenShotName; }
 
     void OnRender(const UIState* pState, const Camera& Cam, SwapChain* pSwapChain);
 
 private:
+    void UpdateDepthPyramid(bool bEnabled);
+    void PlanTransientTargets(uint32_t Width, uint32_t Height);
+    uint32_t GetScenePoolUsage();
+    void SortOpaqueBatchList(std::vector<GltfPbrPass::BatchList> *pBatchList, bool bSort);
+    void DrawDepthPrepass(ID3D12GraphicsCommandList *pCmdLst, const per_frame *pPerFrame, const NodeMask *pVisible);
+    ID3D12GraphicsCommandList *DrawOpaqueBatchList(ID3D12GraphicsCommandList *pCmdLst, CBV_SRV_UAV *pShadowSRV, std::vector<GltfPbrPass::BatchList> *pBatchList, bool bWireframe, bool bClear);
+
     Device                         *m_pDevice;
 
     uint32_t                        m_Width;
@@ -64,11 +99,26 @@ private:
     D3D12_RECT                      m_RectScissor;
     bool                            m_HasTAA = false;
 
+    // how many times the HDR target gets downsampled for the bloom
+    static const uint32_t           DownsampleMipCount = 5;
+
+    // memory the window size dependent targets take, and would take if they were aliased
+    TransientResourcePlanner        m_TransientPlanner;
+
+    // the upload heap gets flushed and reused when it fills up, it only grows past this for scenes with larger textures
+    static const uint32_t           MinUploadHeapSize = 64 * 1024 * 1024;
+
     // Initialize helper classes
     ResourceViewHeaps               m_ResourceViewHeaps;
     UploadHeap                      m_UploadHeap;
+    uint32_t                        m_UploadHeapSize = 0;
+    uint64_t                        m_SceneTextureSize = 0;
     DynamicBufferRing               m_ConstantBufferRing;
     StaticBufferPool                m_VidMemBufferPool;
+    StaticBufferPool                m_SceneBufferPool;  // geometry of the loaded scene, released on UnloadScene
+    uint32_t                        m_ScenePoolSize = 0;
+    D3D12_GPU_VIRTUAL_ADDRESS       m_ScenePoolBase = 0;
+    ScenePoolHistory                m_ScenePoolHistory; // what each scene used of its pool on the previous runs
     CommandListRing                 m_CommandListRing;
     GPUTimestamps                   m_GPUTimer;
 
@@ -78,6 +128,28 @@ private:
     GltfDepthPass                  *m_GLTFDepth;
     GLTFTexturesAndBuffers         *m_pGLTFTexturesAndBuffers;
 
+    // visibility
+    SceneCuller                     m_SceneCuller;
+    NodeMask                        m_CameraVisibility;
+    NodeMask                        m_ShadowVisibility;
+    NodeMask                        m_PrepassVisibility;
+    uint32_t                        m_VisibleNodeCount = 0;
+    uint32_t                        m_OccludedNodeCount = 0;
+    uint32_t                        m_RenderedShadowMapCount = 0;
+    uint32_t                        m_ShadowDrawCount = 0;
+    LightSelector                   m_LightSelector;
+
+    // batch lists, kept across frames, and their ordering
+    std::vector<GltfPbrPass::BatchList> m_OpaqueBatches;
+    std::vector<GltfPbrPass::BatchList> m_TransparentBatches;
+    BatchSorter                     m_BatchSorter;
+    std::vector<uint64_t>           m_BatchSortKeys;
+    std::vector<const void *>       m_BatchPrimitives;
+    std::vector<GltfPbrPass::BatchList> m_SortedBatches;
+    uint32_t                        m_OpaqueBatchCount = 0;
+    uint32_t                        m_RepeatedStateCount = 0;
+    bool                            m_bBatchOrderCached = false;
+
     // effects
     Bloom                           m_Bloom;
     SkyDome                         m_SkyDome;
@@ -115,12 +187,22 @@ private:
         uint32_t    ShadowIndex;
         uint32_t    ShadowResolution;
         uint32_t    LightIndex;
+        bool        bCached;            // the map holds the depth for CachedViewProj, and is in the shader resource state
+        math::Matrix4 CachedViewProj;
     } SceneShadowInfo;
 
     std::vector<SceneShadowInfo>    m_shadowMapPool;
     DSV                             m_ShadowMapPoolDSV;
     CBV_SRV_UAV                     m_ShadowMapPoolSRV;
 
+    // occlusion culling, the depth buffer is read back and turned into a max depth pyramid on the CPU
+    DepthPyramid                    m_DepthPyramid;
+    ID3D12Resource                 *m_pDepthReadback[backBufferCount] = {};
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT m_DepthReadbackFootprint = {};
+    math::Matrix4                   m_DepthReadbackViewProj[backBufferCount];
+    bool                            m_bDepthReadbackPending[backBufferCount] = {};
+    uint32_t                        m_DepthReadbackIndex = 0;
+
     // widgets
     Wireframe                       m_Wireframe;
     WireframeBox                    m_WireframeBox;
@@ -131,4 +213,15 @@ private:
     std::string                     m_pScreenShotName = "";
     SaveTexture                     m_SaveTexture;
     AsyncPool                       m_AsyncPool;
+
+    // the opaque batches get split in chunks that are recorded in parallel into their own command lists,
+    // they come from the command list ring so there can't be more than what's left of it after the main lists
+    // (the shadow maps, the frame and the one after the chunks, and the swapchain one)
+    static const uint32_t           CommandListsPerBackBuffer = 8;
+    static const uint32_t           MainCommandListCount = 4;
+    static const uint32_t           MaxRecordingChunks = CommandListsPerBackBuffer - MainCommandListCount;
+    WorkerPool                      m_WorkerPool;
+    FrameArena                      m_FrameArena;
+    uint32_t                        m_FrameHeapAllocationCount = 0;
+    std::vector<GltfPbrPass::BatchList> m_OpaqueChunks[MaxRecordingChunks];
 };
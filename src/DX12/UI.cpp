@@ -198,6 +198,12 @@ void GLTFSample::BuildUI()
         {
             ImGui::Checkbox("Show Bounding Boxes", &m_UIState.bDrawBoundingBoxes);
             ImGui::Checkbox("Show Light Frustum", &m_UIState.bDrawLightFrustum);
+            ImGui::Checkbox("Frustum Culling", &m_UIState.bFrustumCulling);
+            ImGui::Checkbox("Occlusion Culling", &m_UIState.bOcclusionCulling);
+            ImGui::Checkbox("Cache Shadow Maps", &m_UIState.bCacheShadowMaps);
+            ImGui::Checkbox("Sort Opaque Batches", &m_UIState.bSortOpaqueBatches);
+            ImGui::Checkbox("Depth Prepass", &m_UIState.bDepthPrepass);
+            ImGui::SliderFloat("Texture LOD Bias", &m_UIState.TextureLodBias, 0.0f, 4.0f);
             
             ImGui::Text("Wireframe");
             ImGui::SameLine(); ImGui::RadioButton("Off", (int*)&m_UIState.WireframeMode, (int)UIState::WireframeMode::WIREFRAME_MODE_OFF);
@@ -314,6 +320,17 @@ void GLTFSample::BuildUI()
         ImGui::Text("GPU        : %s", m_systemInfo.mGPUName.c_str());
         ImGui::Text("CPU        : %s", m_systemInfo.mCPUName.c_str());
         ImGui::Text("FPS        : %d (%.2f ms)", fps, frameTime_ms);
+        ImGui::Text("Nodes      : %u / %u visible, %u occluded", m_pRenderer->GetVisibleNodeCount(), m_pRenderer->GetCullableNodeCount(), m_pRenderer->GetOccludedNodeCount());
+        ImGui::Text("Shadows    : %u / %u rendered, %u draws", m_pRenderer->GetRenderedShadowMapCount(), m_pRenderer->GetShadowMapCount(), m_pRenderer->GetShadowDrawCount());
+        ImGui::Text("Lights     : %u / %u selected", m_pRenderer->GetSelectedLightCount(), m_pRenderer->GetLightCount());
+        ImGui::Text("Batches    : %u opaque, %u repeat the previous state%s", m_pRenderer->GetOpaqueBatchCount(), m_pRenderer->GetRepeatedStateCount(), m_pRenderer->IsBatchOrderCached() ? " (cached order)" : "");
+        ImGui::Text("Frame arena: %zu / %zu KB, %u heap allocations", m_pRenderer->GetFrameArena().GetUsedSize() / 1024, m_pRenderer->GetFrameArena().GetSize() / 1024, m_pRenderer->GetFrameArena().GetHeapAllocationCount());
+#ifdef _DEBUG
+        ImGui::Text("Frame heap : %u allocations in OnRender, render thread", m_pRenderer->GetFrameHeapAllocationCount());
+#endif
+        ImGui::Text("Targets    : %llu MB, %llu MB if aliased", (unsigned long long)(m_pRenderer->GetTransientPlanner().GetDedicatedSize() >> 20), (unsigned long long)(m_pRenderer->GetTransientPlanner().GetAliasedSize() >> 20));
+        ImGui::Text("Scene pool : %u KB", m_pRenderer->GetScenePoolSize() / 1024);
+        ImGui::Text("Textures   : %llu MB, mip bias %.1f", (unsigned long long)(m_pRenderer->GetSceneTextureSize() >> 20), m_UIState.TextureLodBias);
 
         if (ImGui::CollapsingHeader("GPU Timings", ImGuiTreeNodeFlags_DefaultOpen))
         {
@@ -348,6 +365,21 @@ void GLTFSample::BuildUI()
                 ImGui::Text("%-18s: %7.2f %s", timeStamps[i].m_label.c_str(), value, pStrUnit);
             }
         }
+
+        if (ImGui::CollapsingHeader("Trace", ImGuiTreeNodeFlags_DefaultOpen))
+        {
+            // CPU scopes and GPU timings in the chrome://tracing format
+            TraceRecorder &recorder = TraceRecorder::Get();
+            bool bRecording = recorder.IsEnabled();
+            if (ImGui::Checkbox("Record", &bRecording))
+                recorder.SetEnabled(bRecording);
+
+            ImGui::SameLine();
+            if (ImGui::Button("Save"))
+                recorder.Save(m_traceFilename);
+
+            ImGui::Text("%zu events", recorder.GetEventCount());
+        }
         ImGui::End(); // PROFILER
     }
 }
@@ -366,8 +398,14 @@ void UIState::Initialize()
     this->Exposure = 1.0f;
     this->IBLFactor = 2.0f;
     this->EmissiveFactor = 1.0f;
+    this->TextureLodBias = 0.0f;
     this->bDrawLightFrustum = false;
     this->bDrawBoundingBoxes = false;
+    this->bFrustumCulling = true;
+    this->bOcclusionCulling = false;
+    this->bCacheShadowMaps = true;
+    this->bSortOpaqueBatches = true;
+    this->bDepthPrepass = false;
     this->WireframeMode = WireframeMode::WIREFRAME_MODE_OFF;
     this->WireframeColor[0] = 0.0f;
     this->WireframeColor[1] = 1.0f;
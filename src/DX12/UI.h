@@ -51,9 +51,15 @@ struct UIState
     //
     float IBLFactor;
     float EmissiveFactor;
+    float TextureLodBias;
 
     int   SelectedSkydomeTypeIndex;
     bool  bDrawBoundingBoxes;
+    bool  bFrustumCulling;
+    bool  bOcclusionCulling;
+    bool  bCacheShadowMaps;
+    bool  bSortOpaqueBatches;
+    bool  bDepthPrepass;
     bool  bDrawLightFrustum;
 
     enum class WireframeMode : int
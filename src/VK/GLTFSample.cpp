@@ -41,9 +41,11 @@ void GLTFSample::OnParseCommandLine(LPSTR lpCmdLine, uint32_t* pWidth, uint32_t*
     *pHeight = 1080;
     m_activeScene = 0;          //load the first one by default
     m_bIsBenchmarking = false;
+    m_bHiddenWindow = false;
     m_VsyncEnabled = false;
     m_fontSize = 13.f;
     m_activeCamera = 0;
+    m_traceFilename = "GLTFSample_trace.json";
 
     // read globals
     auto process = [&](json jData)
@@ -58,6 +60,8 @@ void GLTFSample::OnParseCommandLine(LPSTR lpCmdLine, uint32_t* pWidth, uint32_t*
         m_VsyncEnabled = jData.value("vsync", m_VsyncEnabled);
         m_FreesyncHDROptionEnabled = jData.value("FreesyncHDROptionEnabled", m_FreesyncHDROptionEnabled);
         m_bIsBenchmarking = jData.value("benchmark", m_bIsBenchmarking);
+        m_traceFilename = jData.value("traceFile", m_traceFilename);
+        m_bHiddenWindow = jData.value("hiddenWindow", m_bHiddenWindow);
         m_fontSize = jData.value("fontsize", m_fontSize);
     };
 
@@ -104,6 +108,10 @@ void GLTFSample::OnParseCommandLine(LPSTR lpCmdLine, uint32_t* pWidth, uint32_t*
     // get the list of scenes
     for (const auto & scene : m_jsonConfigFile["scenes"])
         m_sceneNames.push_back(scene["name"]);
+
+    // hidden window runs are only useful as benchmarks, the BenchmarkSettings drive the time and the results go to the CSV
+    if (m_bHiddenWindow)
+        m_bIsBenchmarking = true;
 }
 
 //--------------------------------------------------------------------------------------
@@ -117,9 +125,26 @@ void GLTFSample::OnCreate()
     InitDirectXCompiler();
     CreateShaderCache();
 
+    // Seed the pipeline cache from disk before any pipeline gets created
+    m_pipelineCache.OnCreate(&m_device);
+
     // Create a instance of the renderer and initialize it, we need to do that for each GPU
     m_pRenderer = new Renderer();
-    m_pRenderer->OnCreate(&m_device, &m_swapChain, m_fontSize);
+    m_pRenderer->OnCreate(&m_device, &m_swapChain, m_fontSize, m_bHiddenWindow);
+    m_pRenderer->SetBarrierValidation(m_isCpuValidationLayerEnabled);
+
+    // nothing gets presented, keep the window out of the way. The window and the swapchain still exist, Cauldron creates
+    // them before OnCreate, so this needs a display and is not a headless mode
+    if (m_bHiddenWindow)
+        ShowWindow(m_windowHwnd, SW_HIDE);
+
+    // benchmarks record a trace of the whole run, the benchmark ends the app with exit()
+    if (m_bIsBenchmarking)
+    {
+        TraceRecorder::Get().SetEnabled(true);
+        TraceRecorder::Get().SaveOnExit(m_traceFilename);
+        m_pipelineCache.SaveOnExit();
+    }
 
     // init GUI (non gfx stuff)
     ImGUI_Init((void *)m_windowHwnd);
@@ -149,9 +174,15 @@ void GLTFSample::OnDestroy()
 
     delete m_pRenderer;
 
+    // save the pipelines created during this run, they are merged with the ones we loaded
+    m_pipelineCache.OnDestroy();
+
     // shut down the shader compiler 
     DestroyShaderCache(&m_device);
 
+    m_sceneTransformer.OnDestroy();
+    m_animationSampler.OnDestroy();
+
     if (m_pGltfLoader)
     {
         delete m_pGltfLoader;
@@ -225,15 +256,12 @@ void GLTFSample::LoadScene(int sceneIndex)
 {
     json scene = m_jsonConfigFile["scenes"][sceneIndex];
 
-    // release everything and load the GLTF, just the light json data, the rest (textures and geometry) will be done in the main loop
+    // release the current scene and load the GLTF, just the light json data, the rest (textures and geometry) will be done in the main loop.
+    // Only the per-scene resources are released, the skydome, post processes, GUI and heaps of the renderer stay alive
     if (m_pGltfLoader != NULL)
     {
         m_pRenderer->UnloadScene();
-        m_pRenderer->OnDestroyWindowSizeDependentResources();
-        m_pRenderer->OnDestroy();
         m_pGltfLoader->Unload();
-        m_pRenderer->OnCreate(&m_device, &m_swapChain, m_fontSize);
-        m_pRenderer->OnCreateWindowSizeDependentResources(&m_swapChain, m_Width, m_Height);
     }
 
     delete(m_pGltfLoader);
@@ -244,6 +272,13 @@ void GLTFSample::LoadScene(int sceneIndex)
         exit(0);
     }
 
+    // flatten the node hierarchy of the scene, the transforms get evaluated in parallel every frame
+    m_sceneTransformer.OnCreate(m_pGltfLoader, 0, m_pRenderer->GetWorkerPool());
+    m_animationSampler.OnCreate(m_pGltfLoader);
+
+    // optional CPU benchmark of the animation sampling, see the BusterDrone scene
+    AnimationSampler::Benchmark(m_pGltfLoader, scene.value("animationBenchmarkIterations", 0u));
+
 
     // Load the UI settings, and also some defaults cameras and lights, in case the GLTF has none
     {
@@ -256,6 +291,12 @@ void GLTFSample::LoadScene(int sceneIndex)
         LOAD(scene, "exposure", m_UIState.Exposure);
         LOAD(scene, "iblFactor", m_UIState.IBLFactor);
         LOAD(scene, "emmisiveFactor", m_UIState.EmissiveFactor);
+
+        // the depth prepass only pays off in scenes with a lot of overdraw, so it's off unless the scene asks for it
+        m_UIState.bDepthPrepass = scene.value("depthPrepass", false);
+
+        // scenes with heavy textures can skip their top mips, every level of bias samples a quarter of the texels
+        m_UIState.TextureLodBias = scene.value("textureLodBias", 0.0f);
         LOAD(scene, "skyDomeType", m_UIState.SelectedSkydomeTypeIndex);
 
         // Add a default light in case there are none
@@ -308,6 +349,8 @@ void GLTFSample::LoadScene(int sceneIndex)
 //--------------------------------------------------------------------------------------
 void GLTFSample::OnUpdate()
 {
+    TraceScope traceScope("OnUpdate");
+
     ImGuiIO& io = ImGui::GetIO();
 
     //If the mouse was not used by the GUI then it's for the camera
@@ -338,8 +381,8 @@ void GLTFSample::OnUpdate()
 
     if (m_pGltfLoader)
     {
-        m_pGltfLoader->SetAnimationTime(0, m_time);
-        m_pGltfLoader->TransformScene(0, math::Matrix4::identity());
+        m_animationSampler.SetAnimationTime(m_pGltfLoader, 0, m_time);
+        m_sceneTransformer.TransformScene(math::Matrix4::identity());
     }
 }
 
@@ -417,6 +460,12 @@ void GLTFSample::UpdateCamera(Camera& cam, const ImGuiIO& io)
 //--------------------------------------------------------------------------------------
 void GLTFSample::OnRender()
 {
+    if (m_bHiddenWindow)
+    {
+        OnRenderHiddenWindow();
+        return;
+    }
+
     // Do any start of frame necessities
 	BeginFrame();
 
@@ -432,6 +481,9 @@ void GLTFSample::OnRender()
         {
             m_time = 0;
             m_loadingScene = false;
+
+            // the scene's pipelines are all created by now, save them in case the run doesn't end with OnDestroy
+            m_pipelineCache.Save();
         }
     }
     else if (m_pGltfLoader && m_bIsBenchmarking)
@@ -455,6 +507,49 @@ void GLTFSample::OnRender()
 }
 
 
+//--------------------------------------------------------------------------------------
+//
+// OnRenderHiddenWindow, same as OnRender but without UI and without presenting, the renderer
+// writes into an offscreen LDR target and the benchmark drives the time and the camera
+//
+//--------------------------------------------------------------------------------------
+void GLTFSample::OnRenderHiddenWindow()
+{
+    BeginFrame();
+
+    if (m_pGltfLoader == NULL)
+    {
+        LoadScene(m_activeScene);
+    }
+
+    if (m_loadingScene)
+    {
+        static int loadingStage = 0;
+        loadingStage = m_pRenderer->LoadScene(m_pGltfLoader, loadingStage);
+        if (loadingStage == 0)
+        {
+            m_time = 0;
+            m_loadingScene = false;
+
+            // the scene's pipelines are all created by now, save them in case the run doesn't end with OnDestroy
+            m_pipelineCache.Save();
+        }
+    }
+    else
+    {
+        // BenchmarkLoop writes the per pass timings to the resultsFilename and exits the app when the time ends
+        std::vector<TimeStamp> timeStamps = m_pRenderer->GetTimingValues();
+        std::string Filename;
+        m_time = BenchmarkLoop(timeStamps, &m_camera, Filename);
+
+        m_animationSampler.SetAnimationTime(m_pGltfLoader, 0, m_time);
+        m_sceneTransformer.TransformScene(math::Matrix4::identity());
+    }
+
+    m_pRenderer->OnRender(&m_UIState, m_camera, &m_swapChain);
+}
+
+
 //--------------------------------------------------------------------------------------
 //
 // WinMain
@@ -21,6 +21,10 @@
 #include "base/FrameworkWindows.h"
 #include "Renderer.h"
 #include "UI.h"
+#include "SceneGraphTransformer.h"
+#include "AnimationSampler.h"
+#include "TraceRecorder.h"
+#include "PipelineCache.h"
 
 // This class encapsulates the 'application' and is responsible for handling window events and scene updates (simulation)
 // Rendering and rendering resource management is done by the Renderer class
@@ -41,6 +45,7 @@ public:
     void LoadScene(int sceneIndex);
     
     void OnUpdate();
+    void OnRenderHiddenWindow();
 
     void HandleInput(const ImGuiIO& io);
     void UpdateCamera(Camera& cam, const ImGuiIO& io);
@@ -48,17 +53,23 @@ public:
 private:
 
     bool                        m_bIsBenchmarking;
+    bool                        m_bHiddenWindow; // render offscreen in a hidden window, no UI and no presentation, implies benchmarking
     
     GLTFCommon                 *m_pGltfLoader = NULL;
     bool                        m_loadingScene = false;
+    SceneGraphTransformer       m_sceneTransformer;
+    AnimationSampler            m_animationSampler;
 
     Renderer*                   m_pRenderer = NULL;
+    PipelineCache               m_pipelineCache;
     UIState                     m_UIState;
     float                       m_fontSize;
     Camera                      m_camera;
 
     float                       m_time; // Time accumulator in seconds, used for animation.
 
+    std::string                 m_traceFilename;    // where the CPU/GPU trace gets saved
+
     // json config file
     json                        m_jsonConfigFile;
     std::vector<std::string>    m_sceneNames;
@@ -0,0 +1,172 @@
+// AMD SampleVK sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "stdafx.h"
+#include "PipelineCache.h"
+
+// the cache saved by the atexit handler, the handler can't capture it
+static PipelineCache *s_pExitCache = NULL;
+
+//--------------------------------------------------------------------------------------
+//
+// OnCreate
+//
+//--------------------------------------------------------------------------------------
+void PipelineCache::OnCreate(Device *pDevice)
+{
+    m_pDevice = pDevice;
+    m_bWarm = false;
+    m_loadedSize = 0;
+
+    double startTime = MillisecondsNow();
+
+    std::string deviceName;
+    std::string driverVersion;
+    m_pDevice->GetDeviceInfo(&deviceName, &driverVersion);
+
+    // key the file by the same ids the driver checks in the cache header, the UUID changes with the driver so an
+    // update starts a new file instead of overwriting the one of the previous driver
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(m_pDevice->GetPhysicalDevice(), &props);
+    std::string uuid;
+    for (uint32_t i = 0; i < VK_UUID_SIZE; i++)
+        uuid += format("%02x", props.pipelineCacheUUID[i]);
+    m_filename = GetShaderCompilerCacheDir() + "\\" + format("pipelines_%04x_%04x_%s.vkpc", props.vendorID, props.deviceID, uuid.c_str());
+
+    std::ifstream f(m_filename, std::ios::binary);
+    if (!f)
+    {
+        Trace(format("PipelineCache: cold start, no cache for %s %s\n", deviceName.c_str(), driverVersion.c_str()));
+        return;
+    }
+
+    std::vector<char> data((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    if (!IsCompatible(data))
+    {
+        Trace("PipelineCache: cold start, the cache was created by a different device or driver\n");
+        return;
+    }
+
+    // seed a cache with the data from disk and merge it into the device's cache, the one all the passes create their pipelines with
+    VkPipelineCacheCreateInfo cache_info = {};
+    cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cache_info.initialDataSize = data.size();
+    cache_info.pInitialData = data.data();
+
+    VkPipelineCache loadedCache;
+    VkResult res = vkCreatePipelineCache(m_pDevice->GetDevice(), &cache_info, NULL, &loadedCache);
+    if (res != VK_SUCCESS)
+    {
+        Trace("PipelineCache: cold start, the driver rejected the cache\n");
+        return;
+    }
+
+    VkPipelineCache deviceCache = m_pDevice->GetPipelineCache();
+    res = vkMergePipelineCaches(m_pDevice->GetDevice(), deviceCache, 1, &loadedCache);
+    assert(res == VK_SUCCESS);
+    vkDestroyPipelineCache(m_pDevice->GetDevice(), loadedCache, NULL);
+
+    m_bWarm = (res == VK_SUCCESS);
+    m_loadedSize = data.size();
+    m_loadTimeMs = MillisecondsNow() - startTime;
+
+    Trace(format("PipelineCache: warm start, loaded %zu bytes in %.2f ms\n", m_loadedSize, m_loadTimeMs));
+}
+
+//--------------------------------------------------------------------------------------
+//
+// OnDestroy
+//
+//--------------------------------------------------------------------------------------
+void PipelineCache::OnDestroy()
+{
+    Save();
+
+    if (s_pExitCache == this)
+        s_pExitCache = NULL;
+
+    m_pDevice = NULL;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// Save
+//
+//--------------------------------------------------------------------------------------
+void PipelineCache::Save()
+{
+    if (m_pDevice == NULL)
+        return;
+
+    VkPipelineCache deviceCache = m_pDevice->GetPipelineCache();
+
+    size_t size = 0;
+    VkResult res = vkGetPipelineCacheData(m_pDevice->GetDevice(), deviceCache, &size, NULL);
+    if (res == VK_SUCCESS && size > 0)
+    {
+        std::vector<char> data(size);
+        res = vkGetPipelineCacheData(m_pDevice->GetDevice(), deviceCache, &size, data.data());
+        if (res == VK_SUCCESS)
+        {
+            std::ofstream f(m_filename, std::ios::binary | std::ios::trunc);
+            if (f)
+                f.write(data.data(), size);
+            else
+                Trace(format("PipelineCache: could not write %s\n", m_filename.c_str()));
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------
+//
+// SaveOnExit
+//
+//--------------------------------------------------------------------------------------
+void PipelineCache::SaveOnExit()
+{
+    static bool bRegistered = false;
+    if (!bRegistered)
+        std::atexit([] { if (s_pExitCache) s_pExitCache->Save(); });
+
+    bRegistered = true;
+    s_pExitCache = this;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// IsCompatible, checks the header the driver puts in front of the cache data
+//
+//--------------------------------------------------------------------------------------
+bool PipelineCache::IsCompatible(const std::vector<char> &data) const
+{
+    if (data.size() < sizeof(VkPipelineCacheHeaderVersionOne))
+        return false;
+
+    VkPipelineCacheHeaderVersionOne header;
+    memcpy(&header, data.data(), sizeof(header));
+
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(m_pDevice->GetPhysicalDevice(), &props);
+
+    return header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+        header.vendorID == props.vendorID &&
+        header.deviceID == props.deviceID &&
+        memcmp(header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
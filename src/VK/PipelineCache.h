@@ -0,0 +1,53 @@
+// AMD SampleVK sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include "stdafx.h"
+
+// Persists the device's VkPipelineCache next to the shader cache so the pipelines of the glTF passes, the post
+// processes and ImGUI don't have to be compiled again by the driver on the next run.
+// The file name is keyed by the vendor id, the device id and the pipeline cache UUID, the Vulkan header of the blob
+// is also checked against the physical device so a blob from a different GPU or driver is never fed to vkCreatePipelineCache.
+class PipelineCache
+{
+public:
+    // seeds the device's pipeline cache, call it before creating any pipeline
+    void OnCreate(Device *pDevice);
+    // writes the device's pipeline cache back to disk
+    void OnDestroy();
+
+    // writes the pipelines created so far, the cache stays usable
+    void Save();
+    // saves the cache when the app ends with exit(), like the benchmark does
+    void SaveOnExit();
+
+    bool   IsWarm() const { return m_bWarm; }
+    size_t GetLoadedSize() const { return m_loadedSize; }
+    double GetLoadTimeMs() const { return m_loadTimeMs; }
+
+private:
+    bool IsCompatible(const std::vector<char> &data) const;
+
+    Device      *m_pDevice = NULL;
+    std::string  m_filename;
+    bool         m_bWarm = false;
+    size_t       m_loadedSize = 0;
+    double       m_loadTimeMs = 0.0;
+};
@@ -25,9 +25,10 @@
 // OnCreate
 //
 //--------------------------------------------------------------------------------------
-void Renderer::OnCreate(Device *pDevice, SwapChain *pSwapChain, float FontSize)
+void Renderer::OnCreate(Device *pDevice, SwapChain *pSwapChain, float FontSize, bool bHiddenWindow)
 {
     m_pDevice = pDevice;
+    m_bHiddenWindow = bHiddenWindow;
 
     // Initialize helpers
 
@@ -42,12 +43,44 @@ void Renderer::OnCreate(Device *pDevice, SwapChain *pSwapChain, float FontSize)
     uint32_t commandListsPerBackBuffer = 8;
     m_CommandListRing.OnCreate(pDevice, backBufferCount, commandListsPerBackBuffer);
 
+    // Create the pools for the secondary command buffers recorded by the workers
+    for (int frame = 0; frame < backBufferCount; frame++)
+    {
+        for (uint32_t chunk = 0; chunk < MaxRecordingChunks; chunk++)
+        {
+            VkCommandPoolCreateInfo cmd_pool_info = {};
+            cmd_pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            cmd_pool_info.queueFamilyIndex = pDevice->GetGraphicsQueueFamilyIndex();
+            cmd_pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            VkResult res = vkCreateCommandPool(pDevice->GetDevice(), &cmd_pool_info, NULL, &m_SecondaryCommandPools[frame][chunk]);
+            assert(res == VK_SUCCESS);
+
+            VkCommandBufferAllocateInfo cmd_info = {};
+            cmd_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            cmd_info.commandPool = m_SecondaryCommandPools[frame][chunk];
+            cmd_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            cmd_info.commandBufferCount = 1;
+            res = vkAllocateCommandBuffers(pDevice->GetDevice(), &cmd_info, &m_SecondaryCommandBuffers[frame][chunk]);
+            assert(res == VK_SUCCESS);
+        }
+    }
+    m_SecondaryFrameIndex = 0;
+    m_WorkerPool.OnCreate();
+
+    // Transient containers of the frame being recorded
+    m_FrameArena.OnCreate(256 * 1024);
+    HeapAllocationCounter::InstallHook();
+
+    // the high-water marks of the scene geometry pools, next to the config file
+    m_ScenePoolHistory.Load("GLTFSample_pools.json");
+
     // Create a 'dynamic' constant buffer
     const uint32_t constantBuffersMemSize = 200 * 1024 * 1024;
     m_ConstantBufferRing.OnCreate(pDevice, backBufferCount, constantBuffersMemSize, "Uniforms");
 
-    // Create a 'static' pool for vertices and indices 
-    const uint32_t staticGeometryMemSize = (1 * 128) * 1024 * 1024;
+    // Create a 'static' pool for vertices and indices of the scene independent passes (skydome, widgets, post processes),
+    // the scene gets its own pool in LoadScene so it can be released without tearing down the renderer
+    const uint32_t staticGeometryMemSize = 32 * 1024 * 1024;
     m_VidMemBufferPool.OnCreate(pDevice, staticGeometryMemSize, true, "StaticGeom");
 
     // Create a 'static' pool for vertices and indices in system memory
@@ -58,8 +91,8 @@ void Renderer::OnCreate(Device *pDevice, SwapChain *pSwapChain, float FontSize)
     m_GPUTimer.OnCreate(pDevice, backBufferCount);
 
     // Quick helper to upload resources, it has it's own commandList and uses suballocation.
-    const uint32_t uploadHeapMemSize = 1000 * 1024 * 1024;
-    m_UploadHeap.OnCreate(pDevice, uploadHeapMemSize);    // initialize an upload heap (uses suballocation for faster results)
+    m_UploadHeapSize = MinUploadHeapSize;
+    m_UploadHeap.OnCreate(pDevice, m_UploadHeapSize);    // initialize an upload heap (uses suballocation for faster results)
 
     // Create GBuffer and render passes
     //
@@ -89,6 +122,34 @@ void Renderer::OnCreate(Device *pDevice, SwapChain *pSwapChain, float FontSize)
         m_Render_pass_shadow = CreateRenderPassOptimal(m_pDevice->GetDevice(), 0, NULL, &depthAttachments);
     }
 
+    // Create the depth prepass render pass, it keeps the cleared GBuffer depth and, having the same attachment
+    // format as the shadow render pass, it is compatible with the depth pass pipelines
+    {
+        VkAttachmentDescription depthAttachments;
+        AttachNoClearBeforeUse(VK_FORMAT_D32_SFLOAT, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, &depthAttachments);
+        m_RenderPassDepthPrepass = CreateRenderPassOptimal(m_pDevice->GetDevice(), 0, NULL, &depthAttachments);
+    }
+
+    // Create the offscreen LDR render pass, it uses the swapchain format so it stays compatible with the
+    // tonemapping pipelines that were created for the swapchain's render pass
+    if (m_bHiddenWindow)
+    {
+        VkAttachmentDescription colorAttachment;
+        AttachNoClearBeforeUse(pSwapChain->GetFormat(), VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, &colorAttachment);
+        m_RenderPassOffscreen = CreateRenderPassOptimal(m_pDevice->GetDevice(), 1, &colorAttachment, NULL);
+
+        // there is no swapchain to throttle us, so we need our own fences to know when a frame's command buffers can be recycled
+        VkFenceCreateInfo fence_ci = {};
+        fence_ci.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fence_ci.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        for (int i = 0; i < backBufferCount; i++)
+        {
+            VkResult res = vkCreateFence(m_pDevice->GetDevice(), &fence_ci, NULL, &m_OffscreenFences[i]);
+            assert(res == VK_SUCCESS);
+        }
+        m_OffscreenFrameIndex = 0;
+    }
+
     m_SkyDome.OnCreate(pDevice, m_RenderPassJustDepthAndHdr.GetRenderPass(), &m_UploadHeap, VK_FORMAT_R16G16B16A16_SFLOAT, &m_ResourceViewHeaps, &m_ConstantBufferRing, &m_VidMemBufferPool, "..\\media\\cauldron-media\\envmaps\\papermill\\diffuse.dds", "..\\media\\cauldron-media\\envmaps\\papermill\\specular.dds", VK_SAMPLE_COUNT_1_BIT);
     m_SkyDomeProc.OnCreate(pDevice, m_RenderPassJustDepthAndHdr.GetRenderPass(), &m_UploadHeap, VK_FORMAT_R16G16B16A16_SFLOAT, &m_ResourceViewHeaps, &m_ConstantBufferRing, &m_VidMemBufferPool, VK_SAMPLE_COUNT_1_BIT);
     m_Wireframe.OnCreate(pDevice, m_RenderPassJustDepthAndHdr.GetRenderPass(), &m_ResourceViewHeaps, &m_ConstantBufferRing, &m_VidMemBufferPool, VK_SAMPLE_COUNT_1_BIT);
@@ -103,12 +164,16 @@ void Renderer::OnCreate(Device *pDevice, SwapChain *pSwapChain, float FontSize)
     m_ToneMappingPS.OnCreate(m_pDevice, pSwapChain->GetRenderPass(), &m_ResourceViewHeaps, &m_VidMemBufferPool, &m_ConstantBufferRing);
     m_ColorConversionPS.OnCreate(pDevice, pSwapChain->GetRenderPass(), &m_ResourceViewHeaps, &m_VidMemBufferPool, &m_ConstantBufferRing);
 
-    // Initialize UI rendering resources
-    m_ImGUI.OnCreate(m_pDevice, pSwapChain->GetRenderPass(), &m_UploadHeap, &m_ConstantBufferRing, FontSize);
+    // Initialize UI rendering resources, hidden window runs never draw the UI
+    if (!m_bHiddenWindow)
+        m_ImGUI.OnCreate(m_pDevice, pSwapChain->GetRenderPass(), &m_UploadHeap, &m_ConstantBufferRing, FontSize);
 
     // Make sure upload heap has finished uploading before continuing
     m_VidMemBufferPool.UploadData(m_UploadHeap.GetCommandList());
     m_UploadHeap.FlushAndFinish();
+
+    // nothing else will be allocated from this pool
+    m_VidMemBufferPool.FreeUploadHeap();
 }
 
 //--------------------------------------------------------------------------------------
@@ -120,7 +185,8 @@ void Renderer::OnDestroy()
 {
     m_AsyncPool.Flush();
 
-    m_ImGUI.OnDestroy();
+    if (!m_bHiddenWindow)
+        m_ImGUI.OnDestroy();
     m_ColorConversionPS.OnDestroy();
     m_ToneMappingPS.OnDestroy();
     m_ToneMappingCS.OnDestroy();
@@ -139,6 +205,17 @@ void Renderer::OnDestroy()
     m_GBuffer.OnDestroy();
 
     vkDestroyRenderPass(m_pDevice->GetDevice(), m_Render_pass_shadow, nullptr);
+    vkDestroyRenderPass(m_pDevice->GetDevice(), m_RenderPassDepthPrepass, nullptr);
+    m_RenderPassDepthPrepass = VK_NULL_HANDLE;
+
+    if (m_bHiddenWindow)
+    {
+        vkDestroyRenderPass(m_pDevice->GetDevice(), m_RenderPassOffscreen, nullptr);
+        m_RenderPassOffscreen = VK_NULL_HANDLE;
+
+        for (int i = 0; i < backBufferCount; i++)
+            vkDestroyFence(m_pDevice->GetDevice(), m_OffscreenFences[i], nullptr);
+    }
        
     m_UploadHeap.OnDestroy();
     m_GPUTimer.OnDestroy();
@@ -147,6 +224,14 @@ void Renderer::OnDestroy()
     m_ConstantBufferRing.OnDestroy();
     m_ResourceViewHeaps.OnDestroy();
     m_CommandListRing.OnDestroy();    
+
+    m_WorkerPool.OnDestroy();
+    m_FrameArena.OnDestroy();
+    for (int frame = 0; frame < backBufferCount; frame++)
+    {
+        for (uint32_t chunk = 0; chunk < MaxRecordingChunks; chunk++)
+            vkDestroyCommandPool(m_pDevice->GetDevice(), m_SecondaryCommandPools[frame][chunk], NULL);
+    }
 }
 
 //--------------------------------------------------------------------------------------
@@ -185,13 +270,84 @@ void Renderer::OnCreateWindowSizeDependentResources(SwapChain *pSwapChain, uint3
     m_RenderPassJustDepthAndHdr.OnCreateWindowSizeDependentResources(Width, Height);
     m_RenderPassFullGBuffer.OnCreateWindowSizeDependentResources(Width, Height);
 
+    // Create the frame buffer of the depth prepass, on the GBuffer's depth
+    //
+    {
+        VkImageView attachmentViews[1] = { m_GBuffer.m_DepthBufferDSV };
+        VkFramebufferCreateInfo fb_info = {};
+        fb_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        fb_info.pNext = NULL;
+        fb_info.renderPass = m_RenderPassDepthPrepass;
+        fb_info.attachmentCount = 1;
+        fb_info.pAttachments = attachmentViews;
+        fb_info.width = Width;
+        fb_info.height = Height;
+        fb_info.layers = 1;
+        VkResult res = vkCreateFramebuffer(m_pDevice->GetDevice(), &fb_info, NULL, &m_FramebufferDepthPrepass);
+        assert(res == VK_SUCCESS);
+    }
+
     // Update PostProcessing passes
     //
-    m_DownSample.OnCreateWindowSizeDependentResources(Width, Height, &m_GBuffer.m_HDR, 6); //downsample the HDR texture 6 times
-    m_Bloom.OnCreateWindowSizeDependentResources(Width / 2, Height / 2, m_DownSample.GetTexture(), 6, &m_GBuffer.m_HDR);
+    m_DownSample.OnCreateWindowSizeDependentResources(Width, Height, &m_GBuffer.m_HDR, DownsampleMipCount);
+    m_Bloom.OnCreateWindowSizeDependentResources(Width / 2, Height / 2, m_DownSample.GetTexture(), DownsampleMipCount, &m_GBuffer.m_HDR);
     m_TAA.OnCreateWindowSizeDependentResources(Width, Height, &m_GBuffer);
     m_MagnifierPS.OnCreateWindowSizeDependentResources(&m_GBuffer.m_HDR);
     m_bMagResourceReInit = true;
+    m_StateTracker.Reset();
+
+    // Create the offscreen LDR target that replaces the swapchain when the window is hidden
+    //
+    if (m_bHiddenWindow)
+    {
+        VkImageCreateInfo image_info = {};
+        image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        image_info.pNext = NULL;
+        image_info.imageType = VK_IMAGE_TYPE_2D;
+        image_info.format = pSwapChain->GetFormat();
+        image_info.extent.width = Width;
+        image_info.extent.height = Height;
+        image_info.extent.depth = 1;
+        image_info.mipLevels = 1;
+        image_info.arrayLayers = 1;
+        image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+        image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        image_info.usage = (VkImageUsageFlags)(VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+        image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        m_OffscreenLDR.Init(m_pDevice, &image_info, "OffscreenLDR");
+        m_OffscreenLDR.CreateRTV(&m_OffscreenLDRRTV);
+
+        VkImageView attachmentViews[1] = { m_OffscreenLDRRTV };
+        VkFramebufferCreateInfo fb_info = {};
+        fb_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        fb_info.pNext = NULL;
+        fb_info.renderPass = m_RenderPassOffscreen;
+        fb_info.attachmentCount = 1;
+        fb_info.pAttachments = attachmentViews;
+        fb_info.width = Width;
+        fb_info.height = Height;
+        fb_info.layers = 1;
+        VkResult res = vkCreateFramebuffer(m_pDevice->GetDevice(), &fb_info, NULL, &m_FramebufferOffscreen);
+        assert(res == VK_SUCCESS);
+    }
+
+    PlanTransientTargets(Width, Height);
+}
+
+//--------------------------------------------------------------------------------------
+//
+// PlanTransientTargets, works out how much memory the window size dependent targets would need if the
+// ones with lifetimes that don't overlap shared their memory
+//
+//--------------------------------------------------------------------------------------
+void Renderer::PlanTransientTargets(uint32_t Width, uint32_t Height)
+{
+    const TransientResourcePlanner &planner = m_TransientPlanner;
+    PlanWindowSizeDependentTargets(&m_TransientPlanner, Width, Height, DownsampleMipCount);
+
+    Trace(format("Window size dependent targets at %ux%u: %llu MB, %llu MB with the transient ones sharing %u heaps\n",
+        Width, Height, (unsigned long long)(planner.GetDedicatedSize() >> 20), (unsigned long long)(planner.GetAliasedSize() >> 20), planner.GetHeapCount()));
 }
 
 //--------------------------------------------------------------------------------------
@@ -201,6 +357,15 @@ void Renderer::OnCreateWindowSizeDependentResources(SwapChain *pSwapChain, uint3
 //--------------------------------------------------------------------------------------
 void Renderer::OnDestroyWindowSizeDependentResources()
 {
+    if (m_bHiddenWindow)
+    {
+        vkDestroyFramebuffer(m_pDevice->GetDevice(), m_FramebufferOffscreen, nullptr);
+        vkDestroyImageView(m_pDevice->GetDevice(), m_OffscreenLDRRTV, nullptr);
+        m_OffscreenLDR.OnDestroy();
+        m_FramebufferOffscreen = VK_NULL_HANDLE;
+        m_OffscreenLDRRTV = VK_NULL_HANDLE;
+    }
+
     m_Bloom.OnDestroyWindowSizeDependentResources();
     m_DownSample.OnDestroyWindowSizeDependentResources();
     m_TAA.OnDestroyWindowSizeDependentResources();
@@ -209,6 +374,8 @@ void Renderer::OnDestroyWindowSizeDependentResources()
     m_RenderPassFullGBufferWithClear.OnDestroyWindowSizeDependentResources();
     m_RenderPassJustDepthAndHdr.OnDestroyWindowSizeDependentResources();
     m_RenderPassFullGBuffer.OnDestroyWindowSizeDependentResources();
+    vkDestroyFramebuffer(m_pDevice->GetDevice(), m_FramebufferDepthPrepass, nullptr);
+    m_FramebufferDepthPrepass = VK_NULL_HANDLE;
     m_GBuffer.OnDestroyWindowSizeDependentResources();
 }
 
@@ -219,7 +386,8 @@ void Renderer::OnUpdateDisplayDependentResources(SwapChain *pSwapChain, bool bUs
     m_ColorConversionPS.UpdatePipelines(pSwapChain->GetRenderPass(), pSwapChain->GetDisplayMode());
     m_ToneMappingPS.UpdatePipelines(pSwapChain->GetRenderPass());
 
-    m_ImGUI.UpdatePipeline((pSwapChain->GetDisplayMode() == DISPLAYMODE_SDR) ? pSwapChain->GetRenderPass() : bUseMagnifier ? m_MagnifierPS.GetPassRenderPass() : m_RenderPassJustDepthAndHdr.GetRenderPass());
+    if (!m_bHiddenWindow)
+        m_ImGUI.UpdatePipeline((pSwapChain->GetDisplayMode() == DISPLAYMODE_SDR) ? pSwapChain->GetRenderPass() : bUseMagnifier ? m_MagnifierPS.GetPassRenderPass() : m_RenderPassJustDepthAndHdr.GetRenderPass());
 }
 
 //--------------------------------------------------------------------------------------
@@ -239,15 +407,28 @@ void Renderer::OnUpdateLocalDimmingChangedResources(SwapChain *pSwapChain)
 //--------------------------------------------------------------------------------------
 int Renderer::LoadScene(GLTFCommon *pGLTFCommon, int Stage)
 {
-    // show loading progress
+    // The loading is split in stages that depend on each other, one stage per frame so we can show a progress bar:
     //
-    ImGui::OpenPopup("Loading");
-    if (ImGui::BeginPopupModal("Loading", NULL, ImGuiWindowFlags_AlwaysAutoResize))
+    //   1 - buffers:  parse the glTF buffers, the geometry gets copied into the sysmem side of the static pool
+    //   2 - textures: decode the images as jobs on the async pool, they stream through the upload heap
+    //   3 - passes:   create the depth, PBR and bbox passes back to back (they need the texture views from 2), their
+    //                 shaders and pipelines are compiled as jobs on the async pool so the three passes overlap each other
+    //   4 - flush:    record the geometry copy once, wait for the async jobs and do the only CPU/GPU sync of the load
+    //
+    const int stageCount = 4;
+
+    // show loading progress, hidden window runs have no UI frame to show it in
+    //
+    if (!m_bHiddenWindow)
     {
-        float progress = (float)Stage / 12.0f;
-        ImGui::ProgressBar(progress, ImVec2(0.f, 0.f), NULL);
-        ImGui::EndPopup();
-    } 
+        ImGui::OpenPopup("Loading");
+        if (ImGui::BeginPopupModal("Loading", NULL, ImGuiWindowFlags_AlwaysAutoResize))
+        {
+            float progress = (float)Stage / (float)stageCount;
+            ImGui::ProgressBar(progress, ImVec2(0.f, 0.f), NULL);
+            ImGui::EndPopup();
+        }
+    }
 
     // use multi threading
     AsyncPool *pAsyncPool = &m_AsyncPool;
@@ -256,25 +437,48 @@ int Renderer::LoadScene(GLTFCommon *pGLTFCommon, int Stage)
     //
     if (Stage == 0)
     {
+        // the mip chain of a texture slice is uploaded in one go, resize the heap to fit this scene's largest
+        const uint64_t largestTextureSize = GetLargestTextureUploadSize(pGLTFCommon);
+        const uint64_t uploadHeapMemSize = (std::max<uint64_t>(largestTextureSize, MinUploadHeapSize) + 0xFFFFF) & ~0xFFFFFull;
+        if (uploadHeapMemSize != m_UploadHeapSize)
+        {
+            m_UploadHeap.OnDestroy();
+            m_UploadHeapSize = (uint32_t)uploadHeapMemSize;
+            m_UploadHeap.OnCreate(m_pDevice, m_UploadHeapSize);
+        }
+        Trace(format("Upload heap: %u MB\n", m_UploadHeapSize / (1024 * 1024)));
+
+        m_SceneTextureSize = GetSceneTextureSize(pGLTFCommon);
     }
-    else if (Stage == 5)
+    else if (Stage == 1)
     {   
         Profile p("m_pGltfLoader->Load");
+        TraceScope traceScope("LoadScene: m_pGltfLoader->Load");
+
+        // Create a 'static' pool for the vertices and indices of the scene, sized after what its accessors take or after
+        // what the scene used on a previous run if that was more
+        m_ScenePoolSize = m_ScenePoolHistory.GetPoolSize(pGLTFCommon, GetSceneGeometryPoolSize(pGLTFCommon));
+        m_SceneBufferPool.OnCreate(m_pDevice, m_ScenePoolSize, true, "SceneGeom");
         
         m_pGLTFTexturesAndBuffers = new GLTFTexturesAndBuffers();
-        m_pGLTFTexturesAndBuffers->OnCreate(m_pDevice, pGLTFCommon, &m_UploadHeap, &m_VidMemBufferPool, &m_ConstantBufferRing);
+        m_pGLTFTexturesAndBuffers->OnCreate(m_pDevice, pGLTFCommon, &m_UploadHeap, &m_SceneBufferPool, &m_ConstantBufferRing);
+
+        // per node bounds for the frustum culling
+        m_SceneCuller.OnCreate(pGLTFCommon);
     }
-    else if (Stage == 6)
+    else if (Stage == 2)
     {
         Profile p("LoadTextures");
+        TraceScope traceScope("LoadScene: LoadTextures");
 
         // here we are loading onto the GPU all the textures and the inverse matrices
         // this data will be used to create the PBR and Depth passes       
         m_pGLTFTexturesAndBuffers->LoadTextures(pAsyncPool);
     }
-    else if (Stage == 7)
+    else if (Stage == 3)
     {
-        Profile p("m_GLTFDepth->OnCreate");
+        Profile p("Create passes");
+        TraceScope traceScope("LoadScene: Create passes");
 
         //create the glTF's textures, VBs, IBs, shaders and descriptors for this particular pass    
         m_GLTFDepth = new GltfDepthPass();
@@ -284,26 +488,20 @@ int Renderer::LoadScene(GLTFCommon *pGLTFCommon, int Stage)
             &m_UploadHeap,
             &m_ResourceViewHeaps,
             &m_ConstantBufferRing,
-            &m_VidMemBufferPool,
+            &m_SceneBufferPool,
             m_pGLTFTexturesAndBuffers,
             pAsyncPool
         );
 
-        m_VidMemBufferPool.UploadData(m_UploadHeap.GetCommandList());
-        m_UploadHeap.FlushAndFinish();
-    }
-    else if (Stage == 8)
-    {
-        Profile p("m_GLTFPBR->OnCreate");
-
-        // same thing as above but for the PBR pass
+        // same thing as above but for the PBR pass, no need to wait for the depth pass' uploads, 
+        // they are all in the same static pool and get copied together in the flush stage
         m_GLTFPBR = new GltfPbrPass();
         m_GLTFPBR->OnCreate(
             m_pDevice,
             &m_UploadHeap,
             &m_ResourceViewHeaps,
             &m_ConstantBufferRing,
-            &m_VidMemBufferPool,
+            &m_SceneBufferPool,
             m_pGLTFTexturesAndBuffers,
             &m_SkyDome,
             false, // use SSAO mask
@@ -312,37 +510,35 @@ int Renderer::LoadScene(GLTFCommon *pGLTFCommon, int Stage)
             pAsyncPool
         );
 
-        m_VidMemBufferPool.UploadData(m_UploadHeap.GetCommandList());
-        m_UploadHeap.FlushAndFinish();
-    }
-    else if (Stage == 9)
-    {
-        Profile p("m_GLTFBBox->OnCreate");
-
         // just a bounding box pass that will draw boundingboxes instead of the geometry itself
         m_GLTFBBox = new GltfBBoxPass();
-            m_GLTFBBox->OnCreate(
+        m_GLTFBBox->OnCreate(
             m_pDevice,
             m_RenderPassJustDepthAndHdr.GetRenderPass(),
             &m_ResourceViewHeaps,
             &m_ConstantBufferRing,
-            &m_VidMemBufferPool,
+            &m_SceneBufferPool,
             m_pGLTFTexturesAndBuffers,
             &m_Wireframe
         );
-
-        // we are borrowing the upload heap command list for uploading to the GPU the IBs and VBs
-        m_VidMemBufferPool.UploadData(m_UploadHeap.GetCommandList());
-
     }
-    else if (Stage == 10)
+    else if (Stage == 4)
     {
         Profile p("Flush");
+        TraceScope traceScope("LoadScene: Flush");
+
+        // wait for the pipelines still being compiled by the async pool
+        m_AsyncPool.Flush();
 
+        // all the geometry is in, the pool can't grow so what it used is kept for sizing it on the next run
+        m_ScenePoolHistory.Record(pGLTFCommon, GetScenePoolUsage(), m_ScenePoolSize);
+
+        // we are borrowing the upload heap command list for uploading to the GPU the IBs and VBs of all the passes at once
+        m_SceneBufferPool.UploadData(m_UploadHeap.GetCommandList());
         m_UploadHeap.FlushAndFinish();
 
         //once everything is uploaded we dont need the upload heaps anymore
-        m_VidMemBufferPool.FreeUploadHeap();
+        m_SceneBufferPool.FreeUploadHeap();
 
         // tell caller that we are done loading the map
         return 0;
@@ -352,6 +548,21 @@ int Renderer::LoadScene(GLTFCommon *pGLTFCommon, int Stage)
     return Stage;
 }
 
+//--------------------------------------------------------------------------------------
+//
+// GetScenePoolUsage, Cauldron doesn't tell how much of a StaticBufferPool is used, but a tiny allocation lands right
+// after the last one. Returns UINT32_MAX if the pool is full
+//
+//--------------------------------------------------------------------------------------
+uint32_t Renderer::GetScenePoolUsage()
+{
+    void *pData;
+    VkDescriptorBufferInfo probe;
+    if (!m_SceneBufferPool.AllocBuffer(1, 1, &pData, &probe))
+        return UINT32_MAX;
+    return (uint32_t)probe.offset;
+}
+
 //--------------------------------------------------------------------------------------
 //
 // UnloadScene
@@ -390,8 +601,18 @@ void Renderer::UnloadScene()
         m_pGLTFTexturesAndBuffers->OnDestroy();
         delete m_pGLTFTexturesAndBuffers;
         m_pGLTFTexturesAndBuffers = NULL;
+
+        // the pool was created along with the textures and buffers, all the scene geometry goes away with it
+        m_SceneBufferPool.OnDestroy();
+        m_ScenePoolSize = 0;
+
+        m_SceneCuller.OnDestroy();
     }
 
+    // the state ids are keyed by the primitives and materials of the scene
+    m_BatchSorter.Reset();
+    m_LightSelector.Reset();
+
     assert(m_shadowMapPool.size() == m_ShadowSRVPool.size());
     while (!m_shadowMapPool.empty())
     {
@@ -406,27 +627,27 @@ void Renderer::UnloadScene()
 
 void Renderer::AllocateShadowMaps(GLTFCommon* pGLTFCommon)
 {
+    // The per frame constants only hold MaxShadowInstances shadows, the lights past that are lit without one
+    const uint32_t droppedShadows = m_LightSelector.LimitShadowedLights(pGLTFCommon, MaxShadowInstances);
+    if (droppedShadows)
+        Trace(format("%u lights exceed the %d shadow maps supported, they won't cast shadows\n", droppedShadows, (int)MaxShadowInstances));
+
     // Go through the lights and allocate shadow information
     uint32_t NumShadows = 0;
     for (int i = 0; i < pGLTFCommon->m_lightInstances.size(); ++i)
     {
         const tfLight& lightData = pGLTFCommon->m_lights[pGLTFCommon->m_lightInstances[i].m_lightId];
-        if (lightData.m_shadowResolution)
+        if (m_LightSelector.HasShadow(pGLTFCommon, i))
         {
             SceneShadowInfo ShadowInfo;
             ShadowInfo.ShadowResolution = lightData.m_shadowResolution;
             ShadowInfo.ShadowIndex = NumShadows++;
             ShadowInfo.LightIndex = i;
+            ShadowInfo.bCached = false;
             m_shadowMapPool.push_back(ShadowInfo);
         }
     }
 
-    if (NumShadows > MaxShadowInstances)
-    {
-        Trace("Number of shadows has exceeded maximum supported. Please grow value in gltfCommon.h/perFrameStruct.h");
-        throw;
-    }
-
     // If we had shadow information, allocate all required maps and bindings
     if (!m_shadowMapPool.empty())
     {
@@ -463,6 +684,206 @@ void Renderer::AllocateShadowMaps(GLTFCommon* pGLTFCommon)
     }
 }
 
+//--------------------------------------------------------------------------------------
+//
+// SortOpaqueBatchList
+//
+//--------------------------------------------------------------------------------------
+void Renderer::SortOpaqueBatchList(std::vector<GltfPbrPass::BatchList> *pBatchList, bool bSort)
+{
+    TraceScope traceScope("SortOpaqueBatchList");
+
+    m_OpaqueBatchCount = (uint32_t)pBatchList->size();
+
+    // as long as the same primitives come out of BuildBatchLists the last order holds, skip the keys and the sort
+    m_BatchPrimitives.resize(pBatchList->size());
+    for (size_t i = 0; i < pBatchList->size(); i++)
+        m_BatchPrimitives[i] = (*pBatchList)[i].m_pPrimitive;
+
+    m_bBatchOrderCached = bSort && m_BatchSorter.IsOrderCached(m_BatchPrimitives);
+    if (m_bBatchOrderCached)
+    {
+        m_SortedBatches.clear();
+        for (uint32_t index : m_BatchSorter.GetOrder())
+            m_SortedBatches.push_back((*pBatchList)[index]);
+        pBatchList->swap(m_SortedBatches);
+        return;
+    }
+
+    m_BatchSortKeys.resize(pBatchList->size());
+    for (size_t i = 0; i < pBatchList->size(); i++)
+    {
+        const GltfPbrPass::BatchList &batch = (*pBatchList)[i];
+        const uint32_t materialId = m_BatchSorter.GetMaterialId(batch.m_pPrimitive->m_pMaterial);
+        const uint32_t primitiveId = m_BatchSorter.GetPrimitiveId(batch.m_pPrimitive);
+        m_BatchSortKeys[i] = BatchSorter::MakeKey(materialId, primitiveId, batch.m_depth);
+    }
+
+    if (!bSort)
+    {
+        m_RepeatedStateCount = BatchSorter::CountRepeatedStates(m_BatchSortKeys.data(), (uint32_t)m_BatchSortKeys.size());
+        return;
+    }
+
+    const std::vector<uint32_t> &order = m_BatchSorter.Sort(m_BatchSortKeys);
+    m_RepeatedStateCount = m_BatchSorter.GetRepeatedStateCount();
+
+    m_SortedBatches.clear();
+    for (uint32_t index : order)
+        m_SortedBatches.push_back((*pBatchList)[index]);
+    pBatchList->swap(m_SortedBatches);
+}
+
+//--------------------------------------------------------------------------------------
+//
+// DrawDepthPrepass, lays down the depth of the opaque geometry so the PBR pass only shades the pixels
+// that end up visible, the GBuffer has to be cleared already
+//
+// Cauldron's GltfPbrPass doesn't let us set an EQUAL test with depth writes off, it keeps
+// LESS_EQUAL with writes on. That only rejects the hidden pixels if GltfDepthPass and
+// GltfPbrPass produce bit-identical depth, both transform the positions with the same
+// per-frame matrix and the same skinning code, keep it that way when touching either shader.
+// The prepass has not been measured to pay off on Sponza, so it is off in its config
+//
+//--------------------------------------------------------------------------------------
+void Renderer::DrawDepthPrepass(VkCommandBuffer cmdBuf, const math::Matrix4 &viewProj, const NodeMask *pVisible, const VkRect2D &renderArea)
+{
+    VkRenderPassBeginInfo rp_begin = {};
+    rp_begin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    rp_begin.renderPass = m_RenderPassDepthPrepass;
+    rp_begin.framebuffer = m_FramebufferDepthPrepass;
+    rp_begin.renderArea = renderArea;
+    vkCmdBeginRenderPass(cmdBuf, &rp_begin, VK_SUBPASS_CONTENTS_INLINE);
+
+    SetViewportAndScissor(cmdBuf, renderArea.offset.x, renderArea.offset.y, renderArea.extent.width, renderArea.extent.height);
+
+    GltfDepthPass::per_frame *cbPerFrame = m_GLTFDepth->SetPerFrameConstants();
+    cbPerFrame->mViewProj = viewProj;
+
+    // the nodes with blended primitives would hide what's behind them, they are left to the PBR passes
+    m_SceneCuller.GetDepthPrepassNodes(pVisible, &m_PrepassVisibility);
+    {
+        ScopedNodeVisibility visibility(m_pGLTFTexturesAndBuffers->m_pGLTFCommon, &m_PrepassVisibility, &m_FrameArena);
+        m_GLTFDepth->Draw(cmdBuf);
+    }
+
+    vkCmdEndRenderPass(cmdBuf);
+    m_GPUTimer.GetTimeStamp(cmdBuf, "Depth prepass");
+}
+
+//--------------------------------------------------------------------------------------
+//
+// DrawOpaqueBatchList
+//
+//--------------------------------------------------------------------------------------
+void Renderer::DrawOpaqueBatchList(VkCommandBuffer cmdBuf, std::vector<GltfPbrPass::BatchList> *pBatchList, bool bWireframe, const VkRect2D &renderArea, bool bClear)
+{
+    // below this many batches per chunk the recording is cheaper than waking up the workers
+    const uint32_t minBatchesPerChunk = 256;
+
+    const uint32_t maxChunks = std::min((uint32_t)MaxRecordingChunks, m_WorkerPool.GetThreadCount());
+    const uint32_t batchCount = (uint32_t)pBatchList->size();
+    const uint32_t chunkCount = std::min(maxChunks, (batchCount + minBatchesPerChunk - 1) / minBatchesPerChunk);
+
+    GBufferRenderPass &renderPass = bClear ? m_RenderPassFullGBufferWithClear : m_RenderPassFullGBuffer;
+    if (chunkCount <= 1)
+    {
+        renderPass.BeginPass(cmdBuf, renderArea);
+
+        m_GLTFPBR->DrawBatchList(cmdBuf, pBatchList, bWireframe);
+        m_GPUTimer.GetTimeStamp(cmdBuf, "PBR Opaque");
+
+        renderPass.EndPass(cmdBuf);
+        return;
+    }
+
+    // a render pass instance can't mix inline and secondary contents, so clear the GBuffer with an empty pass
+    // and record the geometry into the pass that loads it
+    if (bClear)
+    {
+        m_RenderPassFullGBufferWithClear.BeginPass(cmdBuf, renderArea);
+        m_RenderPassFullGBufferWithClear.EndPass(cmdBuf);
+    }
+
+    for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+    {
+        const uint32_t first = (batchCount * chunk) / chunkCount;
+        const uint32_t last = (batchCount * (chunk + 1)) / chunkCount;
+        m_OpaqueChunks[chunk].assign(pBatchList->begin() + first, pBatchList->begin() + last);
+    }
+
+    VkCommandBuffer *pSecondaryCmdBufs = m_SecondaryCommandBuffers[m_SecondaryFrameIndex];
+    VkCommandPool *pSecondaryPools = m_SecondaryCommandPools[m_SecondaryFrameIndex];
+
+    m_WorkerPool.ParallelFor(chunkCount, [&](uint32_t chunk)
+    {
+        TraceScope traceScope("Record opaque chunk");
+
+        VkResult res = vkResetCommandPool(m_pDevice->GetDevice(), pSecondaryPools[chunk], 0);
+        assert(res == VK_SUCCESS);
+
+        VkCommandBufferInheritanceInfo inheritance_info = {};
+        inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritance_info.renderPass = m_RenderPassFullGBuffer.GetRenderPass();
+        inheritance_info.subpass = 0;
+        inheritance_info.framebuffer = m_RenderPassFullGBuffer.GetFramebuffer();
+
+        VkCommandBufferBeginInfo cmd_buf_info = {};
+        cmd_buf_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        cmd_buf_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        cmd_buf_info.pInheritanceInfo = &inheritance_info;
+        res = vkBeginCommandBuffer(pSecondaryCmdBufs[chunk], &cmd_buf_info);
+        assert(res == VK_SUCCESS);
+
+        // dynamic state is not inherited from the primary command buffer
+        SetViewportAndScissor(pSecondaryCmdBufs[chunk], renderArea.offset.x, renderArea.offset.y, renderArea.extent.width, renderArea.extent.height);
+        m_GLTFPBR->DrawBatchList(pSecondaryCmdBufs[chunk], &m_OpaqueChunks[chunk], bWireframe);
+
+        res = vkEndCommandBuffer(pSecondaryCmdBufs[chunk]);
+        assert(res == VK_SUCCESS);
+    });
+
+    VkRenderPassBeginInfo rp_begin = {};
+    rp_begin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    rp_begin.renderPass = m_RenderPassFullGBuffer.GetRenderPass();
+    rp_begin.framebuffer = m_RenderPassFullGBuffer.GetFramebuffer();
+    rp_begin.renderArea = renderArea;
+    vkCmdBeginRenderPass(cmdBuf, &rp_begin, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+    vkCmdExecuteCommands(cmdBuf, chunkCount, pSecondaryCmdBufs);
+
+    vkCmdEndRenderPass(cmdBuf);
+    m_GPUTimer.GetTimeStamp(cmdBuf, "PBR Opaque");
+}
+
+//--------------------------------------------------------------------------------------
+//
+// SubmitAndBeginCommandBuffer, submits what was recorded so far and returns a new command buffer to carry on with
+//
+//--------------------------------------------------------------------------------------
+VkCommandBuffer Renderer::SubmitAndBeginCommandBuffer(VkCommandBuffer cmdBuf)
+{
+    VkResult res = vkEndCommandBuffer(cmdBuf);
+    assert(res == VK_SUCCESS);
+
+    VkSubmitInfo submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &cmdBuf;
+    res = vkQueueSubmit(m_pDevice->GetGraphicsQueue(), 1, &submit_info, VK_NULL_HANDLE);
+    assert(res == VK_SUCCESS);
+
+    VkCommandBuffer newCmdBuf = m_CommandListRing.GetNewCommandList();
+
+    VkCommandBufferBeginInfo cmd_buf_info = {};
+    cmd_buf_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    cmd_buf_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    res = vkBeginCommandBuffer(newCmdBuf, &cmd_buf_info);
+    assert(res == VK_SUCCESS);
+
+    return newCmdBuf;
+}
+
 //--------------------------------------------------------------------------------------
 //
 // OnRender
@@ -470,8 +891,16 @@ void Renderer::AllocateShadowMaps(GLTFCommon* pGLTFCommon)
 //--------------------------------------------------------------------------------------
 void Renderer::OnRender(const UIState* pState, const Camera& Cam, SwapChain* pSwapChain)
 {
+    // the heap allocations this thread makes during the frame, only counted in debug builds
+    const uint64_t heapAllocationStart = HeapAllocationCounter::GetThreadCount();
+
+    TraceRecorder::Get().OnBeginFrame();
+    TraceScope traceScope("Renderer::OnRender");
+
     // Let our resource managers do some house keeping 
     m_ConstantBufferRing.OnBeginFrame();
+    m_FrameArena.OnBeginFrame();
+    m_StateTracker.OnBeginFrame();
 
     // command buffer calls
     VkCommandBuffer cmdBuf1 = m_CommandListRing.GetNewCommandList();
@@ -487,13 +916,20 @@ void Renderer::OnRender(const UIState* pState, const Camera& Cam, SwapChain* pSw
     }
 
     m_GPUTimer.OnBeginFrame(cmdBuf1, &m_TimeStamps);
+    TraceRecorder::Get().AddGpuTimestamps(m_TimeStamps, backBufferCount);
 
     // Sets the perFrame data 
     per_frame *pPerFrame = NULL;
     if (m_pGLTFTexturesAndBuffers)
     {
+        // only the lights that reach the view fit in the per frame constants
+        m_LightSelector.Select(m_pGLTFTexturesAndBuffers->m_pGLTFCommon, Cam.GetProjection() * Cam.GetView(), Cam.GetPosition(), MaxLightInstances);
+
         // fill as much as possible using the GLTF (camera, lights, ...)
-        pPerFrame = m_pGLTFTexturesAndBuffers->m_pGLTFCommon->SetPerFrameData(Cam);
+        {
+            ScopedLightSelection lightSelection(m_pGLTFTexturesAndBuffers->m_pGLTFCommon, &m_LightSelector);
+            pPerFrame = m_pGLTFTexturesAndBuffers->m_pGLTFCommon->SetPerFrameData(Cam);
+        }
 
         // Set some lighting factors
         pPerFrame->iblFactor = pState->IBLFactor;
@@ -505,14 +941,18 @@ void Renderer::OnRender(const UIState* pState, const Camera& Cam, SwapChain* pSw
         pPerFrame->wireframeOptions.setY(pState->WireframeColor[1]);
         pPerFrame->wireframeOptions.setZ(pState->WireframeColor[2]);
         pPerFrame->wireframeOptions.setW(pState->WireframeMode == UIState::WireframeMode::WIREFRAME_MODE_SOLID_COLOR ? 1.0f : 0.0f);
-        pPerFrame->lodBias = 0.0f;
+        pPerFrame->lodBias = pState->TextureLodBias;
         m_pGLTFTexturesAndBuffers->SetPerFrameConstants();
         m_pGLTFTexturesAndBuffers->SetSkinningMatricesForSkeletons();
+
+        // the world matrices are final at this point, refresh the bounds used for culling
+        m_SceneCuller.UpdateBounds();
     }
 
     // Render all shadow maps
     if (m_GLTFDepth && pPerFrame != NULL)
     {
+        TraceScope traceShadows("Record shadow maps");
         SetPerfMarkerBegin(cmdBuf1, "ShadowPass");
 
         VkClearValue depth_clear_values[1];
@@ -528,9 +968,24 @@ void Renderer::OnRender(const UIState* pState, const Camera& Cam, SwapChain* pSw
         rp_begin.clearValueCount = 1;
         rp_begin.pClearValues = depth_clear_values;
 
+        m_RenderedShadowMapCount = 0;
+        m_ShadowDrawCount = 0;
+
         std::vector<SceneShadowInfo>::iterator ShadowMap = m_shadowMapPool.begin();
         while (ShadowMap < m_shadowMapPool.end())
         {
+            // a cached map stays valid until its light moves or something moves in front of it
+            const math::Matrix4 &lightViewProj = pPerFrame->lights[m_LightSelector.GetSlot(ShadowMap->LightIndex)].mLightViewProj;
+            const bool bLightMoved = !ShadowMap->bCached || memcmp(&ShadowMap->CachedViewProj, &lightViewProj, sizeof(math::Matrix4)) != 0;
+            if (pState->bCacheShadowMaps && !bLightMoved && !m_SceneCuller.HasMovedNodesInside(lightViewProj))
+            {
+                ++ShadowMap;
+                continue;
+            }
+            ShadowMap->bCached = true;
+            ShadowMap->CachedViewProj = lightViewProj;
+            m_RenderedShadowMapCount++;
+
             // Clear shadow map
             rp_begin.framebuffer = ShadowMap->ShadowFrameBuffer;
             rp_begin.renderArea.extent.width = ShadowMap->ShadowResolution;
@@ -542,9 +997,21 @@ void Renderer::OnRender(const UIState* pState, const Camera& Cam, SwapChain* pSw
 
             // Set per frame constant buffer values
             GltfDepthPass::per_frame* cbPerFrame = m_GLTFDepth->SetPerFrameConstants();
-            cbPerFrame->mViewProj = pPerFrame->lights[ShadowMap->LightIndex].mLightViewProj;
+            cbPerFrame->mViewProj = lightViewProj;
+
+            {
+                const NodeMask *pVisible = NULL;
+                uint32_t drawCount = m_SceneCuller.GetPrimitiveCount();
+                if (pState->bFrustumCulling)
+                {
+                    m_SceneCuller.Cull(cbPerFrame->mViewProj, &m_ShadowVisibility, &drawCount);
+                    pVisible = &m_ShadowVisibility;
+                }
+                m_ShadowDrawCount += drawCount;
 
-            m_GLTFDepth->Draw(cmdBuf1);
+                ScopedNodeVisibility visibility(m_pGLTFTexturesAndBuffers->m_pGLTFCommon, pVisible, &m_FrameArena);
+                m_GLTFDepth->Draw(cmdBuf1);
+            }
 
             m_GPUTimer.GetTimeStamp(cmdBuf1, "Shadow Map Render");
 
@@ -553,6 +1020,10 @@ void Renderer::OnRender(const UIState* pState, const Camera& Cam, SwapChain* pSw
         }
         
         SetPerfMarkerEnd(cmdBuf1);
+
+        // hand the shadow maps over to the GPU, it renders them while the rest of the frame gets recorded
+        if (m_RenderedShadowMapCount > 0)
+            cmdBuf1 = SubmitAndBeginCommandBuffer(cmdBuf1);
     }
 
     // Render Scene to the GBuffer ------------------------------------------------
@@ -564,19 +1035,43 @@ void Renderer::OnRender(const UIState* pState, const Camera& Cam, SwapChain* pSw
     {
         const bool bWireframe = pState->WireframeMode != UIState::WireframeMode::WIREFRAME_MODE_OFF;
 
-        std::vector<GltfPbrPass::BatchList> opaque, transparent;
-        m_GLTFPBR->BuildBatchLists(&opaque, &transparent, bWireframe);
+        // the lists are kept across frames so their storage gets reused
+        std::vector<GltfPbrPass::BatchList> &opaque = m_OpaqueBatches, &transparent = m_TransparentBatches;
+        opaque.clear();
+        transparent.clear();
 
-        // Render opaque 
+        // nodes outside of the camera frustum never make it into the batch lists
+        const NodeMask *pVisible = NULL;
         {
-            m_RenderPassFullGBufferWithClear.BeginPass(cmdBuf1, renderArea);
+            if (pState->bFrustumCulling)
+            {
+                m_VisibleNodeCount = m_SceneCuller.Cull(pPerFrame->mCameraCurrViewProj, &m_CameraVisibility);
+                pVisible = &m_CameraVisibility;
+            }
+            else
+            {
+                m_VisibleNodeCount = m_SceneCuller.GetCullableCount();
+            }
 
-            m_GLTFPBR->DrawBatchList(cmdBuf1, &opaque, bWireframe);
-            m_GPUTimer.GetTimeStamp(cmdBuf1, "PBR Opaque");
+            ScopedNodeVisibility visibility(m_pGLTFTexturesAndBuffers->m_pGLTFCommon, pVisible, &m_FrameArena);
+            TraceScope traceBatchLists("BuildBatchLists");
+            m_GLTFPBR->BuildBatchLists(&opaque, &transparent, bWireframe);
+        }
 
+        SortOpaqueBatchList(&opaque, pState->bSortOpaqueBatches);
+
+        // with the depth laid down first, the PBR pass' depth test rejects all the overdrawn pixels before shading them
+        const bool bDepthPrepass = pState->bDepthPrepass && !bWireframe;
+        if (bDepthPrepass)
+        {
+            m_RenderPassFullGBufferWithClear.BeginPass(cmdBuf1, renderArea);
             m_RenderPassFullGBufferWithClear.EndPass(cmdBuf1);
+            DrawDepthPrepass(cmdBuf1, pPerFrame->mCameraCurrViewProj, pVisible, renderArea);
         }
 
+        // Render opaque 
+        DrawOpaqueBatchList(cmdBuf1, &opaque, bWireframe, renderArea, !bDepthPrepass);
+
         // Render skydome
         {
             m_RenderPassJustDepthAndHdr.BeginPass(cmdBuf1, renderArea);
@@ -662,22 +1157,20 @@ void Renderer::OnRender(const UIState* pState, const Camera& Cam, SwapChain* pSw
         m_RenderPassJustDepthAndHdr.EndPass(cmdBuf1);
     }
 
-    VkImageMemoryBarrier barrier[1] = {};
-    barrier[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier[0].pNext = NULL;
-    barrier[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    barrier[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-    barrier[0].oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-    barrier[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    barrier[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier[0].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier[0].subresourceRange.baseMipLevel = 0;
-    barrier[0].subresourceRange.levelCount = 1;
-    barrier[0].subresourceRange.baseArrayLayer = 0;
-    barrier[0].subresourceRange.layerCount = 1;
-    barrier[0].image = m_GBuffer.m_HDR.Resource();
-    vkCmdPipelineBarrier(cmdBuf1, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, NULL, 0, NULL, 1, barrier);
+    // the GBuffer render passes leave their targets as attachments
+    m_StateTracker.SetState(m_GBuffer.m_HDR.Resource(), VK_IMAGE_ASPECT_COLOR_BIT, "HDR", { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT });
+    m_StateTracker.SetState(m_GBuffer.m_MotionVectors.Resource(), VK_IMAGE_ASPECT_COLOR_BIT, "Motion vectors", { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT });
+    m_StateTracker.SetState(m_GBuffer.m_DepthBuffer.Resource(), VK_IMAGE_ASPECT_DEPTH_BIT, "Depth", { VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT });
+
+    // the HDR goes to the downsample and then gets the bloom blended in, nothing touches the depth and the
+    // motion vectors until TAA so their transitions go in the same barrier
+    m_StateTracker.Transition(m_GBuffer.m_HDR.Resource(), { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_SHADER_READ_BIT });
+    if (pState->bUseTAA)
+    {
+        m_StateTracker.Transition(m_GBuffer.m_DepthBuffer.Resource(), { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT });
+        m_StateTracker.Transition(m_GBuffer.m_MotionVectors.Resource(), { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT });
+    }
+    m_StateTracker.Flush(cmdBuf1);
 
     SetPerfMarkerEnd(cmdBuf1);
 
@@ -695,86 +1188,46 @@ void Renderer::OnRender(const UIState* pState, const Camera& Cam, SwapChain* pSw
         m_Bloom.Draw(cmdBuf1);
         m_GPUTimer.GetTimeStamp(cmdBuf1, "Bloom");
 
+        // the bloom gets blended into the HDR, the pass leaves it readable
+        m_StateTracker.SetState(m_GBuffer.m_HDR.Resource(), VK_IMAGE_ASPECT_COLOR_BIT, "HDR", { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT });
+
         SetPerfMarkerEnd(cmdBuf1);
     }
 
     // Apply TAA & Sharpen to m_HDR
     if (pState->bUseTAA)
     {
-        {
-            VkImageMemoryBarrier barrier = {};
-            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-            barrier.pNext = NULL;
-            barrier.srcAccessMask = 0;
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            barrier.subresourceRange.baseMipLevel = 0;
-            barrier.subresourceRange.levelCount = 1;
-            barrier.subresourceRange.baseArrayLayer = 0;
-            barrier.subresourceRange.layerCount = 1;
-            
-            VkImageMemoryBarrier barriers[3];
-            barriers[0] = barrier;
-            barriers[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-            barriers[0].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-            barriers[0].subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-            barriers[0].image = m_GBuffer.m_DepthBuffer.Resource();
-
-            barriers[1] = barrier;
-            barriers[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-            barriers[1].oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-            barriers[1].image = m_GBuffer.m_MotionVectors.Resource();
-
-            // no layout transition but we still need to wait
-            barriers[2] = barrier;
-            barriers[2].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            barriers[2].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            barriers[2].image = m_GBuffer.m_HDR.Resource();
-
-            vkCmdPipelineBarrier(cmdBuf1, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, 3, barriers);
-        }
+        // no layout transition but we still need to wait for the bloom, the depth and the motion vectors are ready already
+        m_StateTracker.Transition(m_GBuffer.m_HDR.Resource(), { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT });
+        m_StateTracker.Flush(cmdBuf1);
 
         m_TAA.Draw(cmdBuf1);
         m_GPUTimer.GetTimeStamp(cmdBuf1, "TAA");
+
+        // the sharpening writes the HDR back and leaves it readable
+        m_StateTracker.SetState(m_GBuffer.m_HDR.Resource(), VK_IMAGE_ASPECT_COLOR_BIT, "HDR", { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT });
     }
 
 
     // Magnifier Pass: m_HDR as input, pass' own output
     if (pState->bUseMagnifier)
     {
-        VkImageMemoryBarrier barrier = {};
-        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier.pNext = NULL;
-        barrier.srcAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
-        barrier.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
-        barrier.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        barrier.subresourceRange.baseMipLevel = 0;
-        barrier.subresourceRange.levelCount = 1;
-        barrier.subresourceRange.baseArrayLayer = 0;
-        barrier.subresourceRange.layerCount = 1;
-        barrier.image = m_MagnifierPS.GetPassOutputResource();
-
+        // the output is new after a resize, otherwise it was last read by the tonemapper
+        VkImage ImgMagnifierOutput = m_MagnifierPS.GetPassOutputResource();
         if (m_bMagResourceReInit)
         {
-            barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            vkCmdPipelineBarrier(cmdBuf1, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
+            m_StateTracker.SetState(ImgMagnifierOutput, VK_IMAGE_ASPECT_COLOR_BIT, "Magnifier output", { VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0 });
             m_bMagResourceReInit = false;
         }
-        else
-        {
-            barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            vkCmdPipelineBarrier(cmdBuf1, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
-        }
 
-        // Note: assumes the input texture (specified in OnCreateWindowSizeDependentResources()) is in read state
+        m_StateTracker.Transition(ImgMagnifierOutput, { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT });
+        m_StateTracker.Transition(m_GBuffer.m_HDR.Resource(), { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT });
+        m_StateTracker.Flush(cmdBuf1);
+
         m_MagnifierPS.Draw(cmdBuf1, pState->MagnifierParams);
         m_GPUTimer.GetTimeStamp(cmdBuf1, "Magnifier");
+
+        m_StateTracker.SetState(ImgMagnifierOutput, VK_IMAGE_ASPECT_COLOR_BIT, "Magnifier output", { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT });
     }
 
 
@@ -783,37 +1236,19 @@ void Renderer::OnRender(const UIState* pState, const Camera& Cam, SwapChain* pSw
     VkImageView  SRVCurrentInput  = pState->bUseMagnifier ? m_MagnifierPS.GetPassOutputSRV()      : m_GBuffer.m_HDRSRV;
 
     // If using FreeSync HDR, we need to do these in order: Tonemapping -> GUI -> Color Conversion
-    const bool bHDR = pSwapChain->GetDisplayMode() != DISPLAYMODE_SDR;
+    // Hidden window rendering always goes through the SDR path into the offscreen LDR target
+    const bool bHDR = !m_bHiddenWindow && pSwapChain->GetDisplayMode() != DISPLAYMODE_SDR;
     if (bHDR)
     {
         // In place Tonemapping ------------------------------------------------------------------------
         {
-            VkImageMemoryBarrier barrier = {};
-            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-            barrier.pNext = NULL;
-            barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-            barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-            barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
-            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            barrier.subresourceRange.baseMipLevel = 0;
-            barrier.subresourceRange.levelCount = 1;
-            barrier.subresourceRange.baseArrayLayer = 0;
-            barrier.subresourceRange.layerCount = 1;
-            barrier.image = ImgCurrentInput;
-            vkCmdPipelineBarrier(cmdBuf1, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
-            
+            m_StateTracker.Transition(ImgCurrentInput, { VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT });
+            m_StateTracker.Flush(cmdBuf1);
+
             m_ToneMappingCS.Draw(cmdBuf1, SRVCurrentInput, pState->Exposure, pState->SelectedTonemapperIndex, m_Width, m_Height);
 
-            barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-            barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
-            barrier.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-            barrier.image = ImgCurrentInput;
-            vkCmdPipelineBarrier(cmdBuf1, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
-            
+            m_StateTracker.Transition(ImgCurrentInput, { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT });
+            m_StateTracker.Flush(cmdBuf1);
         }
 
         // Render HUD  ------------------------------------------------------------------------
@@ -842,25 +1277,11 @@ void Renderer::OnRender(const UIState* pState, const Camera& Cam, SwapChain* pSw
                 m_RenderPassJustDepthAndHdr.EndPass(cmdBuf1);
             }
 
-            if (bHDR && !pState->bUseMagnifier)
-            {
-                VkImageMemoryBarrier barrier = {};
-                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-                barrier.pNext = NULL;
-                barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-                barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-                barrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-                barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-                barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                barrier.subresourceRange.baseMipLevel = 0;
-                barrier.subresourceRange.levelCount = 1;
-                barrier.subresourceRange.baseArrayLayer = 0;
-                barrier.subresourceRange.layerCount = 1;
-                barrier.image = ImgCurrentInput;
-                vkCmdPipelineBarrier(cmdBuf1, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
-            }
+            // the magnifier's pass leaves its output readable, the GBuffer one leaves the HDR as an attachment
+            if (pState->bUseMagnifier)
+                m_StateTracker.SetState(ImgCurrentInput, VK_IMAGE_ASPECT_COLOR_BIT, "Magnifier output", { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT });
+            else
+                m_StateTracker.SetState(ImgCurrentInput, VK_IMAGE_ASPECT_COLOR_BIT, "HDR", { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT });
 
             m_GPUTimer.GetTimeStamp(cmdBuf1, "ImGUI Rendering");
         }
@@ -886,7 +1307,19 @@ void Renderer::OnRender(const UIState* pState, const Camera& Cam, SwapChain* pSw
     }
 
     // Wait for swapchain (we are going to render to it) -----------------------------------
-    int imageIndex = pSwapChain->WaitForSwapChain();
+    // When the window is hidden wait for the fence of the frame that last used this slot of the command list ring instead
+    int imageIndex = 0;
+    if (m_bHiddenWindow)
+    {
+        VkResult res = vkWaitForFences(m_pDevice->GetDevice(), 1, &m_OffscreenFences[m_OffscreenFrameIndex], VK_TRUE, UINT64_MAX);
+        assert(res == VK_SUCCESS);
+        res = vkResetFences(m_pDevice->GetDevice(), 1, &m_OffscreenFences[m_OffscreenFrameIndex]);
+        assert(res == VK_SUCCESS);
+    }
+    else
+    {
+        imageIndex = pSwapChain->WaitForSwapChain();
+    }
 
     // Keep tracking input/output resource views 
     ImgCurrentInput = pState->bUseMagnifier ? m_MagnifierPS.GetPassOutputResource() : m_GBuffer.m_HDR.Resource(); // these haven't changed, re-assign as sanity check
@@ -894,6 +1327,9 @@ void Renderer::OnRender(const UIState* pState, const Camera& Cam, SwapChain* pSw
 
     m_CommandListRing.OnBeginFrame();
 
+    // the secondary command buffers follow the same ring as the primary ones
+    m_SecondaryFrameIndex = (m_SecondaryFrameIndex + 1) % backBufferCount;
+
     VkCommandBuffer cmdBuf2 = m_CommandListRing.GetNewCommandList();
 
     {
@@ -908,13 +1344,17 @@ void Renderer::OnRender(const UIState* pState, const Camera& Cam, SwapChain* pSw
 
     SetPerfMarkerBegin(cmdBuf2, "Swapchain RenderPass");
 
+    // the color conversion or the tonemapper read the result of the post processing
+    m_StateTracker.Transition(ImgCurrentInput, { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT });
+    m_StateTracker.Flush(cmdBuf2);
+
     // prepare render pass
     {
         VkRenderPassBeginInfo rp_begin = {};
         rp_begin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
         rp_begin.pNext = NULL;
-        rp_begin.renderPass = pSwapChain->GetRenderPass();
-        rp_begin.framebuffer = pSwapChain->GetFramebuffer(imageIndex);
+        rp_begin.renderPass = m_bHiddenWindow ? m_RenderPassOffscreen : pSwapChain->GetRenderPass();
+        rp_begin.framebuffer = m_bHiddenWindow ? m_FramebufferOffscreen : pSwapChain->GetFramebuffer(imageIndex);
         rp_begin.renderArea.offset.x = 0;
         rp_begin.renderArea.offset.y = 0;
         rp_begin.renderArea.extent.width = m_Width;
@@ -943,6 +1383,7 @@ void Renderer::OnRender(const UIState* pState, const Camera& Cam, SwapChain* pSw
         }
 
         // Render HUD  -------------------------------------------------------------------------
+        if (!m_bHiddenWindow)
         {
             m_ImGUI.Draw(cmdBuf2);
             m_GPUTimer.GetTimeStamp(cmdBuf2, "ImGUI Rendering");
@@ -956,6 +1397,23 @@ void Renderer::OnRender(const UIState* pState, const Camera& Cam, SwapChain* pSw
     vkCmdEndRenderPass(cmdBuf2);
    
     // Close & Submit the command list ----------------------------------------------------
+    if (m_bHiddenWindow)
+    {
+        VkResult res = vkEndCommandBuffer(cmdBuf2);
+        assert(res == VK_SUCCESS);
+
+        VkSubmitInfo submit_info2 = {};
+        submit_info2.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info2.pNext = NULL;
+        submit_info2.commandBufferCount = 1;
+        submit_info2.pCommandBuffers = &cmdBuf2;
+
+        res = vkQueueSubmit(m_pDevice->GetGraphicsQueue(), 1, &submit_info2, m_OffscreenFences[m_OffscreenFrameIndex]);
+        assert(res == VK_SUCCESS);
+
+        m_OffscreenFrameIndex = (m_OffscreenFrameIndex + 1) % backBufferCount;
+    }
+    else
     {
         VkResult res = vkEndCommandBuffer(cmdBuf2);
         assert(res == VK_SUCCESS);
@@ -980,4 +1438,8 @@ void Renderer::OnRender(const UIState* pState, const Camera& Cam, SwapChain* pSw
         res = vkQueueSubmit(m_pDevice->GetGraphicsQueue(), 1, &submit_info2, CmdBufExecutedFences);
         assert(res == VK_SUCCESS);
     }
+
+    // only steady state frames are reported, the frames where the arena had to grow are still warming up
+    if (m_FrameArena.GetHeapAllocationCount() == 0)
+        m_FrameHeapAllocationCount = (uint32_t)(HeapAllocationCounter::GetThreadCount() - heapAllocationStart);
 }
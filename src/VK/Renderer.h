@@ -22,6 +22,16 @@
 
 #include "base/GBuffer.h"
 #include "PostProc/MagnifierPS.h"
+#include "SceneCulling.h"
+#include "LightSelection.h"
+#include "BatchSorting.h"
+#include "FrameArena.h"
+#include "HeapAllocationCounter.h"
+#include "WorkerPool.h"
+#include "TraceRecorder.h"
+#include "TransientResources.h"
+#include "ScenePools.h"
+#include "ResourceStateTracker.h"
 
 // We are queuing (backBufferCount + 0.5) frames, so we need to triple buffer the resources that get modified each frame
 static const int backBufferCount = 3;
@@ -35,7 +45,7 @@ struct UIState;
 class Renderer
 {
 public:
-    void OnCreate(Device *pDevice, SwapChain *pSwapChain, float FontSize);
+    void OnCreate(Device *pDevice, SwapChain *pSwapChain, float FontSize, bool bHiddenWindow = false);
     void OnDestroy();
 
     void OnCreateWindowSizeDependentResources(SwapChain *pSwapChain, uint32_t Width, uint32_t Height);
@@ -49,11 +59,39 @@ public:
 
     void AllocateShadowMaps(GLTFCommon* pGLTFCommon);
 
+    WorkerPool *GetWorkerPool() { return &m_WorkerPool; }
+
+    uint32_t GetCullableNodeCount() const { return m_SceneCuller.GetCullableCount(); }
+    uint32_t GetVisibleNodeCount() const { return m_VisibleNodeCount; }
+    uint32_t GetShadowMapCount() const { return (uint32_t)m_shadowMapPool.size(); }
+    uint32_t GetRenderedShadowMapCount() const { return m_RenderedShadowMapCount; }
+    uint32_t GetShadowDrawCount() const { return m_ShadowDrawCount; }
+    uint32_t GetLightCount() const { return m_LightSelector.GetLightCount(); }
+    uint32_t GetSelectedLightCount() const { return m_LightSelector.GetSelectedCount(); }
+    uint32_t GetOpaqueBatchCount() const { return m_OpaqueBatchCount; }
+    uint32_t GetRepeatedStateCount() const { return m_RepeatedStateCount; }
+    bool IsBatchOrderCached() const { return m_bBatchOrderCached; }
+    const FrameArena &GetFrameArena() const { return m_FrameArena; }
+    uint32_t GetFrameHeapAllocationCount() const { return m_FrameHeapAllocationCount; }
+    const TransientResourcePlanner &GetTransientPlanner() const { return m_TransientPlanner; }
+    uint32_t GetScenePoolSize() const { return m_ScenePoolSize; }
+    uint64_t GetSceneTextureSize() const { return m_SceneTextureSize; }
+    const ResourceStateTracker &GetStateTracker() const { return m_StateTracker; }
+
+    void SetBarrierValidation(bool bEnabled) { m_StateTracker.SetValidation(bEnabled); }
+
     const std::vector<TimeStamp> &GetTimingValues() { return m_TimeStamps; }
 
     void OnRender(const UIState* pState, const Camera& Cam, SwapChain* pSwapChain);
 
 private:
+    VkCommandBuffer SubmitAndBeginCommandBuffer(VkCommandBuffer cmdBuf);
+    void PlanTransientTargets(uint32_t Width, uint32_t Height);
+    uint32_t GetScenePoolUsage();
+    void SortOpaqueBatchList(std::vector<GltfPbrPass::BatchList> *pBatchList, bool bSort);
+    void DrawDepthPrepass(VkCommandBuffer cmdBuf, const math::Matrix4 &viewProj, const NodeMask *pVisible, const VkRect2D &renderArea);
+    void DrawOpaqueBatchList(VkCommandBuffer cmdBuf, std::vector<GltfPbrPass::BatchList> *pBatchList, bool bWireframe, const VkRect2D &renderArea, bool bClear);
+
     Device *m_pDevice;
 
     uint32_t                        m_Width;
@@ -62,11 +100,25 @@ private:
     VkRect2D                        m_RectScissor;
     VkViewport                      m_Viewport;
 
+    // how many times the HDR target gets downsampled for the bloom
+    static const uint32_t           DownsampleMipCount = 6;
+
+    // memory the window size dependent targets take, and would take if they were aliased
+    TransientResourcePlanner        m_TransientPlanner;
+
+    // the upload heap gets flushed and reused when it fills up, it only grows past this for scenes with larger textures
+    static const uint32_t           MinUploadHeapSize = 64 * 1024 * 1024;
+
     // Initialize helper classes
     ResourceViewHeaps               m_ResourceViewHeaps;
     UploadHeap                      m_UploadHeap;
+    uint32_t                        m_UploadHeapSize = 0;
+    uint64_t                        m_SceneTextureSize = 0;
     DynamicBufferRing               m_ConstantBufferRing;
     StaticBufferPool                m_VidMemBufferPool;
+    StaticBufferPool                m_SceneBufferPool;  // geometry of the loaded scene, released on UnloadScene
+    uint32_t                        m_ScenePoolSize = 0;
+    ScenePoolHistory                m_ScenePoolHistory; // what each scene used of its pool on the previous runs
     StaticBufferPool                m_SysMemBufferPool;
     CommandListRing                 m_CommandListRing;
     GPUTimestamps                   m_GPUTimer;
@@ -77,6 +129,27 @@ private:
     GltfDepthPass                  *m_GLTFDepth;
     GLTFTexturesAndBuffers         *m_pGLTFTexturesAndBuffers;
 
+    // visibility
+    SceneCuller                     m_SceneCuller;
+    NodeMask                        m_CameraVisibility;
+    NodeMask                        m_ShadowVisibility;
+    NodeMask                        m_PrepassVisibility;
+    uint32_t                        m_VisibleNodeCount = 0;
+    uint32_t                        m_RenderedShadowMapCount = 0;
+    uint32_t                        m_ShadowDrawCount = 0;
+    LightSelector                   m_LightSelector;
+
+    // batch lists, kept across frames, and their ordering
+    std::vector<GltfPbrPass::BatchList> m_OpaqueBatches;
+    std::vector<GltfPbrPass::BatchList> m_TransparentBatches;
+    BatchSorter                     m_BatchSorter;
+    std::vector<uint64_t>           m_BatchSortKeys;
+    std::vector<const void *>       m_BatchPrimitives;
+    std::vector<GltfPbrPass::BatchList> m_SortedBatches;
+    uint32_t                        m_OpaqueBatchCount = 0;
+    uint32_t                        m_RepeatedStateCount = 0;
+    bool                            m_bBatchOrderCached = false;
+
     // effects
     Bloom                           m_Bloom;
     SkyDome                         m_SkyDome;
@@ -89,6 +162,9 @@ private:
     MagnifierPS                     m_MagnifierPS;
     bool                            m_bMagResourceReInit = false;
 
+    // layouts and accesses of the GBuffer and post processing images
+    ResourceStateTracker            m_StateTracker;
+
     // GUI
     ImGUI                           m_ImGUI;
 
@@ -98,6 +174,10 @@ private:
     GBufferRenderPass               m_RenderPassJustDepthAndHdr;
     GBufferRenderPass               m_RenderPassFullGBuffer;
 
+    // depth prepass, it renders into the GBuffer's depth with the depth pass pipelines
+    VkRenderPass                    m_RenderPassDepthPrepass = VK_NULL_HANDLE;
+    VkFramebuffer                   m_FramebufferDepthPrepass = VK_NULL_HANDLE;
+
     // shadowmaps
     VkRenderPass                    m_Render_pass_shadow;
 
@@ -108,11 +188,22 @@ private:
         uint32_t        LightIndex;
         VkImageView     ShadowDSV;
         VkFramebuffer   ShadowFrameBuffer;
+        bool            bCached;            // the map holds the depth for CachedViewProj
+        math::Matrix4   CachedViewProj;
     } SceneShadowInfo;
 
     std::vector<SceneShadowInfo>    m_shadowMapPool;
     std::vector< VkImageView>       m_ShadowSRVPool;
 
+    // hidden window rendering, the LDR output goes to an offscreen target instead of the swapchain
+    bool                            m_bHiddenWindow = false;
+    VkRenderPass                    m_RenderPassOffscreen = VK_NULL_HANDLE;
+    Texture                         m_OffscreenLDR;
+    VkImageView                     m_OffscreenLDRRTV = VK_NULL_HANDLE;
+    VkFramebuffer                   m_FramebufferOffscreen = VK_NULL_HANDLE;
+    VkFence                         m_OffscreenFences[backBufferCount];
+    uint32_t                        m_OffscreenFrameIndex = 0;
+
     // widgets
     Wireframe                       m_Wireframe;
     WireframeBox                    m_WireframeBox;
@@ -120,5 +211,16 @@ private:
     std::vector<TimeStamp>          m_TimeStamps;
 
     AsyncPool                       m_AsyncPool;
+
+    // the opaque batches get split in chunks that are recorded in parallel into secondary command buffers,
+    // each chunk has its own pool per frame so the workers never share one
+    static const uint32_t           MaxRecordingChunks = 8;
+    WorkerPool                      m_WorkerPool;
+    FrameArena                      m_FrameArena;
+    uint32_t                        m_FrameHeapAllocationCount = 0;
+    VkCommandPool                   m_SecondaryCommandPools[backBufferCount][MaxRecordingChunks];
+    VkCommandBuffer                 m_SecondaryCommandBuffers[backBufferCount][MaxRecordingChunks];
+    std::vector<GltfPbrPass::BatchList> m_OpaqueChunks[MaxRecordingChunks];
+    uint32_t                        m_SecondaryFrameIndex = 0;
 };
 
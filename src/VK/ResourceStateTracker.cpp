@@ -0,0 +1,203 @@
+// AMD SampleVK sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "stdafx.h"
+#include "ResourceStateTracker.h"
+
+// the accesses that have to be made available before anything else touches the image
+static const VkAccessFlags WriteAccessMask =
+    VK_ACCESS_SHADER_WRITE_BIT |
+    VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_TRANSFER_WRITE_BIT |
+    VK_ACCESS_HOST_WRITE_BIT |
+    VK_ACCESS_MEMORY_WRITE_BIT;
+
+//--------------------------------------------------------------------------------------
+//
+// OnBeginFrame
+//
+//--------------------------------------------------------------------------------------
+void ResourceStateTracker::OnBeginFrame()
+{
+    assert(m_pending.empty());
+
+    m_transitionCount = 0;
+    m_barrierCount = 0;
+    m_redundantCount = 0;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// Reset, forgets all the images, call it when they get recreated
+//
+//--------------------------------------------------------------------------------------
+void ResourceStateTracker::Reset()
+{
+    m_images.clear();
+    m_pending.clear();
+    m_pendingSrcStages = 0;
+    m_pendingDstStages = 0;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// Find
+//
+//--------------------------------------------------------------------------------------
+ResourceStateTracker::TrackedImage *ResourceStateTracker::Find(VkImage image)
+{
+    // a handful of images, a linear search is all it takes
+    for (TrackedImage &tracked : m_images)
+    {
+        if (tracked.image == image)
+            return &tracked;
+    }
+    return NULL;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// SetState
+//
+//--------------------------------------------------------------------------------------
+void ResourceStateTracker::SetState(VkImage image, VkImageAspectFlags aspect, const char *pName, const State &state)
+{
+    // a state that reads the image has already been made visible the last write
+    const VkAccessFlags writeAccess = state.access & WriteAccessMask;
+    const VkPipelineStageFlags writeStages = writeAccess ? state.stages : 0;
+
+    TrackedImage *pTracked = Find(image);
+    if (pTracked == NULL)
+    {
+        m_images.push_back({ image, aspect, pName, state, writeStages, writeAccess });
+        return;
+    }
+
+    pTracked->aspect = aspect;
+    pTracked->pName = pName;
+    pTracked->state = state;
+    pTracked->writeStages = writeStages;
+    pTracked->writeAccess = writeAccess;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// Transition
+//
+//--------------------------------------------------------------------------------------
+void ResourceStateTracker::Transition(VkImage image, const State &state)
+{
+    TrackedImage *pTracked = Find(image);
+    assert(pTracked != NULL && "the image has to be given a state with SetState first");
+    if (pTracked == NULL)
+        return;
+
+    State &current = pTracked->state;
+    const bool bReadAfterRead = current.layout == state.layout && (current.access & WriteAccessMask) == 0 && (state.access & WriteAccessMask) == 0;
+    if (bReadAfterRead)
+    {
+        // the stages and accesses that already waited for the last write need no barrier
+        if ((state.stages & ~current.stages) == 0 && (state.access & ~current.access) == 0)
+        {
+            m_redundantCount++;
+            if (m_bValidation)
+                Trace(format("ResourceStateTracker: redundant transition of %s, it is already readable in layout %d\n", pTracked->pName, (int)state.layout));
+            return;
+        }
+
+        // a new reader queued along with the first one just widens its barrier
+        for (VkImageMemoryBarrier &pending : m_pending)
+        {
+            if (pending.image == image)
+            {
+                pending.dstAccessMask |= state.access;
+                m_pendingDstStages |= state.stages;
+                current.stages |= state.stages;
+                current.access |= state.access;
+                return;
+            }
+        }
+    }
+
+#ifdef _DEBUG
+    // an image can only be transitioned once per barrier
+    for (const VkImageMemoryBarrier &pending : m_pending)
+        assert(pending.image != image);
+#endif
+
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.pNext = NULL;
+    barrier.srcAccessMask = pTracked->writeAccess;              // reads don't need to be made available
+    barrier.dstAccessMask = state.access;
+    barrier.oldLayout = current.layout;
+    barrier.newLayout = state.layout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.subresourceRange.aspectMask = pTracked->aspect;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+    barrier.image = image;
+    m_pending.push_back(barrier);
+
+    // an image coming from an undefined layout has nothing to wait for. Otherwise wait for the last write and for the
+    // readers since, they chain to the barrier that made the write (or the layout transition) visible to them.
+    m_pendingSrcStages |= current.layout == VK_IMAGE_LAYOUT_UNDEFINED ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT : (current.stages | pTracked->writeStages);
+    m_pendingDstStages |= state.stages;
+
+    if (bReadAfterRead)
+    {
+        // more readers of the same write, the write stays the one later readers wait for
+        current.stages |= state.stages;
+        current.access |= state.access;
+    }
+    else
+    {
+        current = state;
+        if (state.access & WriteAccessMask)
+        {
+            pTracked->writeStages = state.stages;
+            pTracked->writeAccess = state.access & WriteAccessMask;
+        }
+    }
+    m_transitionCount++;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// Flush
+//
+//--------------------------------------------------------------------------------------
+void ResourceStateTracker::Flush(VkCommandBuffer cmdBuf)
+{
+    if (m_pending.empty())
+        return;
+
+    const VkPipelineStageFlags srcStages = m_pendingSrcStages != 0 ? m_pendingSrcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    vkCmdPipelineBarrier(cmdBuf, srcStages, m_pendingDstStages, 0, 0, NULL, 0, NULL, (uint32_t)m_pending.size(), m_pending.data());
+    m_barrierCount++;
+
+    m_pending.clear();
+    m_pendingSrcStages = 0;
+    m_pendingDstStages = 0;
+}
@@ -0,0 +1,79 @@
+// AMD SampleVK sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include "stdafx.h"
+
+// Keeps the layout and the last access of the images of the post processing chain, so each pass asks for the state
+// it needs instead of hand writing the barrier. The transitions are queued and flushed together in a single
+// vkCmdPipelineBarrier, their source stages and accesses are the ones of the last writer and of the readers since.
+// Passes that change an image's layout by themselves (render passes, Cauldron's post processes) report the state
+// they leave it in with SetState.
+class ResourceStateTracker
+{
+public:
+    struct State
+    {
+        VkImageLayout           layout;
+        VkPipelineStageFlags    stages;
+        VkAccessFlags           access;
+    };
+
+    void OnBeginFrame();
+    void Reset();
+
+    // records the state an image was left in without a barrier of ours, it also starts tracking the image
+    void SetState(VkImage image, VkImageAspectFlags aspect, const char *pName, const State &state);
+    // queues the transition to the state the next pass needs, a read in the same layout by stages and accesses that
+    // were already made visible the last write is dropped
+    void Transition(VkImage image, const State &state);
+    // records all the queued transitions in one barrier
+    void Flush(VkCommandBuffer cmdBuf);
+
+    // in validation mode the dropped transitions get traced, the code asking for them can go
+    void SetValidation(bool bEnabled) { m_bValidation = bEnabled; }
+
+    uint32_t GetTransitionCount() const { return m_transitionCount; }
+    uint32_t GetBarrierCount() const { return m_barrierCount; }
+    uint32_t GetRedundantCount() const { return m_redundantCount; }
+
+private:
+    struct TrackedImage
+    {
+        VkImage                 image;
+        VkImageAspectFlags      aspect;
+        const char             *pName;
+        State                   state;          // layout, and the stages and accesses synchronized with the last write
+        VkPipelineStageFlags    writeStages;    // last write, later readers in other stages have to wait for it
+        VkAccessFlags           writeAccess;
+    };
+
+    TrackedImage *Find(VkImage image);
+
+    std::vector<TrackedImage>           m_images;
+    std::vector<VkImageMemoryBarrier>   m_pending;
+    VkPipelineStageFlags                m_pendingSrcStages = 0;
+    VkPipelineStageFlags                m_pendingDstStages = 0;
+
+    bool                                m_bValidation = false;
+    uint32_t                            m_transitionCount = 0;
+    uint32_t                            m_barrierCount = 0;
+    uint32_t                            m_redundantCount = 0;
+};
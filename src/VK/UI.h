@@ -52,10 +52,15 @@ struct UIState
     //
     float IBLFactor;
     float EmissiveFactor;
+    float TextureLodBias;
     int   SelectedSkydomeTypeIndex;
 
     bool  bDrawLightFrustum;
     bool  bDrawBoundingBoxes;
+    bool  bFrustumCulling;
+    bool  bCacheShadowMaps;
+    bool  bSortOpaqueBatches;
+    bool  bDepthPrepass;
 
     enum class WireframeMode : int
     {